@@ -61,10 +61,13 @@ int main(int argc, char** ppArgv)
 		("m,normalmap", "Normal map file (gltfx/glbx only)", cxxopts::value<string>())
 		("e,embedmaps", "Embed map images (gltfx/glbx only)", cxxopts::value<bool>())
 		("t,objectspacenormals", "Use object space normals (gltfx/glbx only)", cxxopts::value<bool>())
+		("normalencoding", "Normal encoding: float, oct8 or oct16 (gltfx/glbx only)", cxxopts::value<string>())
+		("octnormalsonly", "Omit NORMAL with oct8/oct16, viewer decodes _NORMAL_OCT (gltfx/glbx only)", cxxopts::value<bool>())
 		("p,compress", "Compress mesh data using Draco (gltfx/glbx only)", cxxopts::value<bool>())
 		("j,joinvertices", "Join identical vertices", cxxopts::value<bool>())
 		("n,stripnormals", "Strip normals", cxxopts::value<bool>())
 		("u,striptexcoords", "Strip texture coords", cxxopts::value<bool>())
+		("keepcolors", "Keep vertex colors", cxxopts::value<bool>())
 		("z,swizzle", "Swizzle coordinates", cxxopts::value<string>())
 		("s,scale", "Scale scene by given factor", cxxopts::value<float>())
 		("flipuv", "Flip UV y coordinate", cxxopts::value<bool>())
@@ -109,7 +112,12 @@ int main(int argc, char** ppArgv)
 				cout << jsonParsed.dump(jsonIndent) << endl;
 			}
 
-			options.fromJSON(jsonParsed);
+			Result optionsResult = options.fromJSON(jsonParsed);
+			if (optionsResult.isError()) {
+				cout << Scene::getJsonStatus(string("invalid JSON configuration file: ") + configFilePath
+					+ ", reason: " + optionsResult.message()).dump(jsonIndent);
+				exit(1);
+			}
 		}
 
 		if (options.verbose) {
@@ -130,12 +138,31 @@ int main(int argc, char** ppArgv)
 		options.joinVertices = parsed.count("joinvertices") || options.joinVertices;
 		options.stripNormals = parsed.count("stripnormals") || options.stripNormals;
 		options.stripTexCoords = parsed.count("striptexcoords") || options.stripTexCoords;
+		options.keepColors = parsed.count("keepcolors") || options.keepColors;
 		options.swizzle = parsed.count("swizzle") ? parsed["swizzle"].as<string>() : options.swizzle;
 		options.scale = parsed.count("scale") ? parsed["scale"].as<float>() : options.scale;
 		options.flipUV = parsed.count("flipuv") ? parsed["flipuv"].as<bool>() : options.flipUV;
 
 		options.useCompression = parsed.count("compress") || options.useCompression;
 		options.objectSpaceNormals = parsed.count("objectspacenormals") || options.objectSpaceNormals;
+		options.octNormalsOnly = parsed.count("octnormalsonly") || options.octNormalsOnly;
+
+		if (parsed.count("normalencoding")) {
+			string encoding = parsed["normalencoding"].as<string>();
+			if (encoding == "float") {
+				options.normalEncoding = meshsmith::NormalEncoding::Float;
+			}
+			else if (encoding == "oct8") {
+				options.normalEncoding = meshsmith::NormalEncoding::Oct8;
+			}
+			else if (encoding == "oct16") {
+				options.normalEncoding = meshsmith::NormalEncoding::Oct16;
+			}
+			else {
+				cout << Scene::getJsonStatus("invalid normal encoding: " + encoding).dump(jsonIndent);
+				exit(1);
+			}
+		}
 		options.embedMaps = parsed.count("embedmaps") || options.embedMaps;
 		options.diffuseMap = parsed.count("diffusemap") ? parsed["diffusemap"].as<string>() : options.diffuseMap;
 		options.occlusionMap = parsed.count("occlusionmap") ? parsed["occlusionmap"].as<string>() : options.occlusionMap;
@@ -193,7 +220,13 @@ int main(int argc, char** ppArgv)
 		exit(1);
 	}
 
-	cout << Scene::getJsonStatus().dump(jsonIndent);
+	json status = Scene::getJsonStatus();
+	json exportReport = scene.getJsonExportReport();
+	if (!exportReport.empty()) {
+		status["export"] = exportReport;
+	}
+
+	cout << status.dump(jsonIndent);
 	exit(0);
 
 }
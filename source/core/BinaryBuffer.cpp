@@ -0,0 +1,335 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BinaryBuffer.h"
+#include "MappedFile.h"
+#include "OutputFile.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace meshsmith;
+using namespace flow;
+
+// alignment of buffer views, satisfies all glTF component types
+static const size_t _viewAlignment = 4;
+
+// size of the chunks generated by one thread when writing generated sources
+static const size_t _generatorChunkSize = 4 * 1024 * 1024;
+
+static size_t _alignOffset(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MemorySource::MemorySource(const void* pData, size_t byteLength, std::shared_ptr<const void> pOwner) :
+	_pData(pData),
+	_byteLength(byteLength),
+	_pOwner(pOwner)
+{
+}
+
+Result MemorySource::write(OutputFile& file) const
+{
+	file.append(_pData, _byteLength);
+	return Result::ok();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GeneratedSource::GeneratedSource(size_t numElements, size_t elementSize, generator_t generator) :
+	_numElements(numElements),
+	_elementSize(elementSize),
+	_generator(generator)
+{
+}
+
+Result GeneratedSource::write(OutputFile& file) const
+{
+	if (_numElements == 0 || _elementSize == 0) {
+		return Result::ok();
+	}
+
+	// each thread generates whole chunks, threads are started once per batch of chunks;
+	// queued data must stay valid until flushed, so each batch is flushed before the memory is reused
+	size_t chunkElements = std::max(_generatorChunkSize / _elementSize, size_t(1));
+	size_t batchElements = chunkElements * parallelThreadCount();
+	std::vector<char> batch(std::min(batchElements, _numElements) * _elementSize);
+
+	for (size_t first = 0; first < _numElements; first += batchElements) {
+		size_t count = std::min(batchElements, _numElements - first);
+		char* pBatch = batch.data();
+
+		parallelFor(0, count, [this, first, pBatch](size_t begin, size_t end) {
+			_generator(first + begin, end - begin, pBatch + begin * _elementSize);
+		}, chunkElements);
+
+		file.append(pBatch, count * _elementSize);
+		if (!file.flush()) {
+			return Result::error("failed to write file: " + file.filePath());
+		}
+	}
+
+	return Result::ok();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<FileSource> FileSource::create(const std::string& filePath, bool preload)
+{
+	auto pMappedFile = std::make_shared<MappedFile>();
+	if (!pMappedFile->open(filePath)) {
+		return nullptr;
+	}
+
+	std::shared_ptr<FileSource> pSource(new FileSource(filePath, pMappedFile->size()));
+
+	if (preload) {
+		pMappedFile->prefetch();
+		pSource->_pMappedFile = pMappedFile;
+	}
+
+	return pSource;
+}
+
+FileSource::FileSource(const std::string& filePath, size_t byteLength) :
+	_filePath(filePath),
+	_byteLength(byteLength)
+{
+}
+
+Result FileSource::write(OutputFile& file) const
+{
+	// a preloaded file is still mapped, otherwise the mapping is released after this call
+	MappedFile mappedFile;
+	const MappedFile* pMappedFile = _pMappedFile.get();
+
+	if (!pMappedFile) {
+		if (!mappedFile.open(_filePath)) {
+			return Result::error("failed to map file: " + _filePath);
+		}
+		if (mappedFile.size() != _byteLength) {
+			return Result::error("file has changed during export: " + _filePath);
+		}
+		pMappedFile = &mappedFile;
+	}
+
+	// write queued data now, the temporary mapping doesn't outlive this call
+	file.append(pMappedFile->data(), pMappedFile->size());
+	if (!file.flush()) {
+		return Result::error("failed to write file: " + file.filePath());
+	}
+
+	return Result::ok();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryView::BinaryView(size_t index, size_t group, std::shared_ptr<BinarySource> pSource) :
+	_index(index),
+	_group(group),
+	_bufferIndex(0),
+	_byteOffset(0),
+	_byteStride(0),
+	_priority(0),
+	_target(ViewTarget::None),
+	_pSource(pSource)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryBuffer::BinaryBuffer() :
+	_groups(1),
+	_currentGroup(0)
+{
+}
+
+void BinaryBuffer::setGroup(const std::string& name)
+{
+	auto it = std::find(_groups.begin(), _groups.end(), name);
+	_currentGroup = size_t(it - _groups.begin());
+
+	if (it == _groups.end()) {
+		_groups.push_back(name);
+	}
+}
+
+BinaryView* BinaryBuffer::addView(std::shared_ptr<BinarySource> pSource, ViewTarget target)
+{
+	BinaryView* pView = new BinaryView(_views.size(), _currentGroup, pSource);
+	pView->setTarget(target);
+	_views.push_back(std::unique_ptr<BinaryView>(pView));
+	return pView;
+}
+
+BinaryView* BinaryBuffer::addMemory(const void* pData, size_t byteLength, ViewTarget target)
+{
+	return addView(std::make_shared<MemorySource>(pData, byteLength), target);
+}
+
+BinaryView* BinaryBuffer::addData(const void* pData, size_t byteLength, ViewTarget target)
+{
+	std::vector<char> data(byteLength);
+	if (byteLength > 0) {
+		memcpy(data.data(), pData, byteLength);
+	}
+
+	return addView(MemorySource::fromVector(std::move(data)), target);
+}
+
+BinaryView* BinaryBuffer::addFile(const std::string& filePath)
+{
+	auto pSource = FileSource::create(filePath);
+	if (!pSource) {
+		return nullptr;
+	}
+
+	return addView(pSource);
+}
+
+size_t BinaryBuffer::layout(const BinaryLayoutOptions& options)
+{
+	_buffers.clear();
+	_stages.clear();
+	_layout.clear();
+
+	for (auto& pView : _views) {
+		_layout.push_back(pView.get());
+	}
+
+	// groups are kept together in the order of their first view, sorted by priority within
+	bool separateGroups = options.separateGroups;
+	bool orderByPriority = options.orderByPriority;
+
+	if (separateGroups || orderByPriority) {
+		std::stable_sort(_layout.begin(), _layout.end(), [separateGroups, orderByPriority](const BinaryView* pA, const BinaryView* pB) {
+			if (separateGroups && pA->_group != pB->_group) {
+				return pA->_group < pB->_group;
+			}
+			return orderByPriority && pA->_priority < pB->_priority;
+		});
+	}
+
+	size_t offset = 0;
+
+	for (BinaryView* pView : _layout) {
+		offset = _alignOffset(offset, _viewAlignment);
+
+		// a view with a new priority starts a stage, aligned within the current buffer
+		bool newStage = orderByPriority && (_stages.empty() || _stages.back().bufferIndex != _buffers.size() - 1
+			|| _stages.back().priority != pView->_priority);
+
+		size_t viewOffset = newStage && offset > 0 ? _alignOffset(offset, options.stageAlignment) : offset;
+
+		// start a new buffer if the view doesn't fit (a view is never split) or a new group starts
+		bool newGroup = separateGroups && !_buffers.empty() && _buffers.back().group != pView->_group;
+		bool full = offset > 0 && viewOffset + pView->byteLength() > options.maxBufferSize;
+
+		if (_buffers.empty() || newGroup || full) {
+			if (!_buffers.empty()) {
+				_buffers.back().byteLength = offset;
+			}
+			buffer_t buffer = { 0, pView->_group, separateGroups };
+			_buffers.push_back(buffer);
+			newStage = orderByPriority;
+			viewOffset = 0;
+		}
+
+		size_t bufferIndex = _buffers.size() - 1;
+		offset = viewOffset;
+
+		if (newStage) {
+			BinaryStage stage = { pView->_priority, bufferIndex, offset, 0 };
+			_stages.push_back(stage);
+		}
+
+		pView->_bufferIndex = bufferIndex;
+		pView->_byteOffset = offset;
+		offset += pView->byteLength();
+
+		if (orderByPriority) {
+			_stages.back().byteLength = offset - _stages.back().byteOffset;
+		}
+	}
+
+	if (!_buffers.empty()) {
+		_buffers.back().byteLength = _alignOffset(offset, _viewAlignment);
+	}
+
+	return _buffers.size();
+}
+
+std::string BinaryBuffer::bufferGroup(size_t bufferIndex) const
+{
+	const buffer_t& buffer = _buffers[bufferIndex];
+	return buffer.isGrouped ? _groups[buffer.group] : std::string();
+}
+
+Result BinaryBuffer::write(OutputFile& file, size_t bufferIndex) const
+{
+	size_t startOffset = file.byteLength();
+
+	for (const BinaryView* pView : _layout) {
+		if (pView->_bufferIndex != bufferIndex) {
+			continue;
+		}
+
+		size_t offset = file.byteLength() - startOffset;
+		file.appendPadding(pView->_byteOffset - offset);
+
+		auto result = pView->_pSource->write(file);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	file.appendPadding(byteLength(bufferIndex) - (file.byteLength() - startOffset));
+
+	if (!file.flush()) {
+		return Result::error("failed to write file: " + file.filePath());
+	}
+
+	return Result::ok();
+}
+
+json BinaryBuffer::viewsToJSON() const
+{
+	json jsonViews = json::array();
+
+	for (auto& pView : _views) {
+		json jsonView = {
+			{ "buffer", pView->_bufferIndex },
+			{ "byteOffset", pView->_byteOffset },
+			{ "byteLength", pView->byteLength() }
+		};
+
+		if (pView->_byteStride > 0) {
+			jsonView["byteStride"] = pView->_byteStride;
+		}
+		if (pView->_target != ViewTarget::None) {
+			jsonView["target"] = uint32_t(pView->_target);
+		}
+
+		jsonViews.push_back(jsonView);
+	}
+
+	return jsonViews;
+}
@@ -0,0 +1,264 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_BINARYBUFFER_H
+#define _MESHSMITH_BINARYBUFFER_H
+
+#include "library.h"
+
+#include "core/json.h"
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <limits>
+
+namespace meshsmith
+{
+	class OutputFile;
+	class MappedFile;
+
+	/// Target hint of a glTF buffer view.
+	enum class ViewTarget : uint32_t
+	{
+		None = 0,
+		ArrayBuffer = 34962,
+		ElementArrayBuffer = 34963
+	};
+
+	/// Provides the content of a buffer view. The content is requested only
+	/// when the buffer is written, sources never need to be copied into a
+	/// contiguous in-memory buffer.
+	class MESHSMITH_CORE_EXPORT BinarySource
+	{
+	public:
+		virtual ~BinarySource() {}
+
+		/// Returns the size of the content in bytes.
+		virtual size_t byteLength() const = 0;
+		/// Queues or writes the content to the given file.
+		virtual flow::Result write(OutputFile& file) const = 0;
+	};
+
+	/// Source referencing a block of memory. If an owner is given, the source keeps
+	/// it alive, otherwise the memory must stay valid until the buffer has been written.
+	class MESHSMITH_CORE_EXPORT MemorySource : public BinarySource
+	{
+	public:
+		MemorySource(const void* pData, size_t byteLength, std::shared_ptr<const void> pOwner = nullptr);
+
+		/// Creates a source taking ownership of the given vector.
+		template<typename T>
+		static std::shared_ptr<MemorySource> fromVector(std::vector<T>&& data);
+
+		size_t byteLength() const override { return _byteLength; }
+		flow::Result write(OutputFile& file) const override;
+
+		const void* data() const { return _pData; }
+
+	private:
+		const void* _pData;
+		size_t _byteLength;
+		std::shared_ptr<const void> _pOwner;
+	};
+
+	/// Source generating its content at write time, e.g. data derived from a mesh
+	/// in a different layout. The content is produced in chunks of whole elements,
+	/// so the complete data never exists in memory. Chunks are generated in parallel,
+	/// the generator is called concurrently for disjoint ranges.
+	class MESHSMITH_CORE_EXPORT GeneratedSource : public BinarySource
+	{
+	public:
+		/// Called with the range of elements to generate and the destination memory.
+		typedef std::function<void(size_t firstElement, size_t numElements, void* pDst)> generator_t;
+
+		GeneratedSource(size_t numElements, size_t elementSize, generator_t generator);
+
+		size_t byteLength() const override { return _numElements * _elementSize; }
+		flow::Result write(OutputFile& file) const override;
+
+	private:
+		size_t _numElements;
+		size_t _elementSize;
+		generator_t _generator;
+	};
+
+	/// Source streaming the content of a file. The file is memory-mapped
+	/// only while it is written, unless it is preloaded.
+	class MESHSMITH_CORE_EXPORT FileSource : public BinarySource
+	{
+	public:
+		/// Creates a source for the given file. Returns nullptr if the file can't be read.
+		/// A preloaded file stays mapped and is read into memory before create() returns,
+		/// the file is then written from the mapping without opening it again.
+		static std::shared_ptr<FileSource> create(const std::string& filePath, bool preload = false);
+
+		size_t byteLength() const override { return _byteLength; }
+		flow::Result write(OutputFile& file) const override;
+
+		const std::string& filePath() const { return _filePath; }
+
+	private:
+		FileSource(const std::string& filePath, size_t byteLength);
+
+		std::string _filePath;
+		size_t _byteLength;
+		std::shared_ptr<MappedFile> _pMappedFile;
+	};
+
+	struct BinaryLayoutOptions
+	{
+		/// Maximum size of a buffer, unless a single view is larger.
+		size_t maxBufferSize;
+		/// Start a new buffer for each group of views.
+		bool separateGroups;
+		/// Place views in order of ascending priority. Each priority forms a stage
+		/// starting at a multiple of stageAlignment, so a partially received
+		/// buffer can be used stage by stage.
+		bool orderByPriority;
+		size_t stageAlignment;
+
+		BinaryLayoutOptions() :
+			maxBufferSize(std::numeric_limits<size_t>::max()),
+			separateGroups(false),
+			orderByPriority(false),
+			stageAlignment(4096) { }
+	};
+
+	/// Range of a buffer holding the views of one priority.
+	struct BinaryStage
+	{
+		int priority;
+		size_t bufferIndex;
+		size_t byteOffset;
+		size_t byteLength;
+	};
+
+	/// Buffer view with a deferred source. The buffer it is placed in and its
+	/// offset within that buffer are assigned by BinaryBuffer::layout().
+	class MESHSMITH_CORE_EXPORT BinaryView
+	{
+		friend class BinaryBuffer;
+
+	public:
+		size_t index() const { return _index; }
+		size_t group() const { return _group; }
+		size_t bufferIndex() const { return _bufferIndex; }
+		size_t byteOffset() const { return _byteOffset; }
+		size_t byteLength() const { return _pSource->byteLength(); }
+
+		void setTarget(ViewTarget target) { _target = target; }
+		ViewTarget target() const { return _target; }
+		void setByteStride(size_t byteStride) { _byteStride = byteStride; }
+		size_t byteStride() const { return _byteStride; }
+		/// Views with lower priority are placed first in a prioritized layout, default is 0.
+		void setPriority(int priority) { _priority = priority; }
+		int priority() const { return _priority; }
+
+		const BinarySource* source() const { return _pSource.get(); }
+
+	private:
+		BinaryView(size_t index, size_t group, std::shared_ptr<BinarySource> pSource);
+
+		size_t _index;
+		size_t _group;
+		size_t _bufferIndex;
+		size_t _byteOffset;
+		size_t _byteStride;
+		int _priority;
+		ViewTarget _target;
+		std::shared_ptr<BinarySource> _pSource;
+	};
+
+	/// Binary glTF buffers assembled from buffer views. Views are laid out before
+	/// writing, so the asset JSON can reference them before any binary data is
+	/// produced. Each view is then streamed directly from its source. If the views
+	/// exceed the maximum buffer size, they are distributed over several buffers.
+	/// Views can be organized in named groups, e.g. per mesh, which are placed in
+	/// separate buffers if requested.
+	class MESHSMITH_CORE_EXPORT BinaryBuffer
+	{
+	public:
+		BinaryBuffer();
+
+		BinaryBuffer(const BinaryBuffer& other) = delete;
+		BinaryBuffer& operator=(const BinaryBuffer& other) = delete;
+
+	public:
+		/// Views added after this call belong to the group with the given name.
+		void setGroup(const std::string& name);
+
+		/// Adds a view with the given source.
+		BinaryView* addView(std::shared_ptr<BinarySource> pSource, ViewTarget target = ViewTarget::None);
+		/// Adds a view referencing external memory without taking ownership.
+		/// The memory must stay valid until the buffer has been written.
+		BinaryView* addMemory(const void* pData, size_t byteLength, ViewTarget target = ViewTarget::None);
+		/// Adds a view with a copy of the given data.
+		BinaryView* addData(const void* pData, size_t byteLength, ViewTarget target = ViewTarget::None);
+		/// Adds a view streaming the given file. Returns nullptr if the file can't be read.
+		BinaryView* addFile(const std::string& filePath);
+
+		/// Assigns views to buffers and 4-byte aligned offsets within them.
+		/// Returns the number of buffers.
+		size_t layout(const BinaryLayoutOptions& options = BinaryLayoutOptions());
+		/// Writes all views of the given buffer including alignment padding to the file.
+		flow::Result write(OutputFile& file, size_t bufferIndex = 0) const;
+
+		/// Returns the glTF "bufferViews" array.
+		flow::json viewsToJSON() const;
+
+		size_t bufferCount() const { return _buffers.size(); }
+		size_t byteLength(size_t bufferIndex = 0) const { return bufferIndex < _buffers.size() ? _buffers[bufferIndex].byteLength : 0; }
+		/// Returns the name of the group whose views are stored in the given buffer.
+		/// Empty unless groups are laid out separately.
+		std::string bufferGroup(size_t bufferIndex) const;
+
+		size_t viewCount() const { return _views.size(); }
+		const BinaryView* view(size_t index) const { return _views[index].get(); }
+
+		/// Returns the priority stages of a prioritized layout, in file order.
+		const std::vector<BinaryStage>& stages() const { return _stages; }
+
+	private:
+		struct buffer_t
+		{
+			size_t byteLength;
+			size_t group;
+			bool isGrouped;
+		};
+
+		std::vector<std::unique_ptr<BinaryView>> _views;
+		std::vector<std::string> _groups;
+		size_t _currentGroup;
+
+		std::vector<buffer_t> _buffers;
+		std::vector<BinaryStage> _stages;
+		/// Views sorted by buffer and offset.
+		std::vector<BinaryView*> _layout;
+	};
+
+	template<typename T>
+	std::shared_ptr<MemorySource> MemorySource::fromVector(std::vector<T>&& data)
+	{
+		auto pData = std::make_shared<std::vector<T>>(std::move(data));
+		return std::make_shared<MemorySource>(pData->data(), pData->size() * sizeof(T), pData);
+	}
+}
+
+#endif // _MESHSMITH_BINARYBUFFER_H
@@ -0,0 +1,360 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompressedFile.h"
+#include "MappedFile.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(MESHSMITH_HAS_ZLIB)
+# include <zlib.h>
+#endif
+
+#if defined(MESHSMITH_HAS_BROTLI)
+# include <brotli/encode.h>
+#endif
+
+using namespace meshsmith;
+
+// size of the blocks compressed independently, large enough that the dictionary priming costs little
+static const size_t _blockSize = 1024 * 1024;
+
+// deflate window size, each gzip block is primed with this much of the preceding data
+static const size_t _dictionarySize = 32 * 1024;
+
+// content is compressed once and served many times, use the best ratio
+static const int _gzipLevel = 9;
+
+// brotli quality 11 is several times slower for little gain on binary data
+static const int _brotliQuality = 9;
+static const int _brotliWindowBits = 22;
+
+
+std::vector<CompressionFormat> meshsmith::precompressionFormats(Precompression precompression)
+{
+	std::vector<CompressionFormat> formats;
+
+	if (precompression == Precompression::Gzip || precompression == Precompression::GzipBrotli) {
+		formats.push_back(CompressionFormat::Gzip);
+	}
+	if (precompression == Precompression::Brotli || precompression == Precompression::GzipBrotli) {
+		formats.push_back(CompressionFormat::Brotli);
+	}
+
+	return formats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+CompressedFile::CompressedFile() :
+	_format(CompressionFormat::Gzip),
+	_failed(false),
+	_crc(0),
+	_byteLength(0),
+	_pBrotliEncoder(nullptr)
+{
+}
+
+CompressedFile::~CompressedFile()
+{
+	close();
+}
+
+bool CompressedFile::isAvailable(CompressionFormat format)
+{
+	switch (format) {
+#if defined(MESHSMITH_HAS_ZLIB)
+	case CompressionFormat::Gzip:
+		return true;
+#endif
+#if defined(MESHSMITH_HAS_BROTLI)
+	case CompressionFormat::Brotli:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+flow::Result CompressedFile::checkAvailable(Precompression precompression)
+{
+	for (auto format : precompressionFormats(precompression)) {
+		if (!isAvailable(format)) {
+			return flow::Result::error("precompression format not supported by this build: " + fileExtension(format));
+		}
+	}
+
+	return flow::Result::ok();
+}
+
+std::string CompressedFile::fileExtension(CompressionFormat format)
+{
+	return format == CompressionFormat::Brotli ? ".br" : ".gz";
+}
+
+bool CompressedFile::compressFile(const std::string& filePath, CompressionFormat format)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.open(filePath)) {
+		return false;
+	}
+
+	CompressedFile file;
+	if (!file.open(filePath + fileExtension(format), format)) {
+		return false;
+	}
+
+	file.write(mappedFile.data(), mappedFile.size());
+	return file.close();
+}
+
+bool CompressedFile::open(const std::string& filePath, CompressionFormat format)
+{
+	close();
+
+	_format = format;
+	_failed = false;
+	_input.clear();
+	_pDictionary = nullptr;
+	_byteLength = 0;
+
+	if (!isAvailable(format) || !_file.open(filePath)) {
+		return false;
+	}
+
+#if defined(MESHSMITH_HAS_ZLIB)
+	if (format == CompressionFormat::Gzip) {
+		_crc = crc32(0, Z_NULL, 0);
+
+		// no file name or time stamp, extra flags: maximum compression, OS: unknown
+		const unsigned char header[] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 2, 255 };
+		_file.write(header, sizeof(header));
+	}
+#endif
+
+#if defined(MESHSMITH_HAS_BROTLI)
+	if (format == CompressionFormat::Brotli) {
+		BrotliEncoderState* pEncoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+		BrotliEncoderSetParameter(pEncoder, BROTLI_PARAM_QUALITY, _brotliQuality);
+		BrotliEncoderSetParameter(pEncoder, BROTLI_PARAM_LGWIN, _brotliWindowBits);
+		_pBrotliEncoder = pEncoder;
+	}
+#endif
+
+	_input.reserve(_blockSize);
+	return true;
+}
+
+bool CompressedFile::close()
+{
+	if (!_file.isOpen()) {
+		return !_failed;
+	}
+
+	// the last block terminates the stream, even if it is empty
+	_submitBlock(true);
+
+	while (!_blocks.empty()) {
+		_writeBlock();
+	}
+
+#if defined(MESHSMITH_HAS_ZLIB)
+	if (_format == CompressionFormat::Gzip) {
+		const uint32_t trailer[] = { uint32_t(_crc), uint32_t(_byteLength) };
+		_file.write(trailer, sizeof(trailer));
+	}
+#endif
+
+#if defined(MESHSMITH_HAS_BROTLI)
+	if (_pBrotliEncoder) {
+		BrotliEncoderDestroyInstance((BrotliEncoderState*)_pBrotliEncoder);
+		_pBrotliEncoder = nullptr;
+	}
+#endif
+
+	if (!_file.close()) {
+		_failed = true;
+	}
+
+	_input = std::vector<char>();
+	_pDictionary = nullptr;
+	return !_failed;
+}
+
+void CompressedFile::write(const void* pData, size_t byteLength)
+{
+	if (!_file.isOpen()) {
+		return;
+	}
+
+	const char* pSrc = (const char*)pData;
+
+	while (byteLength > 0) {
+		size_t size = std::min(byteLength, _blockSize - _input.size());
+		_input.insert(_input.end(), pSrc, pSrc + size);
+		pSrc += size;
+		byteLength -= size;
+
+		if (_input.size() == _blockSize) {
+			_submitBlock(false);
+		}
+	}
+}
+
+void CompressedFile::_submitBlock(bool isLast)
+{
+	auto pInput = std::make_shared<std::vector<char>>(std::move(_input));
+	_input = std::vector<char>();
+	_input.reserve(_blockSize);
+
+	std::shared_future<block_t> block;
+
+	if (_format == CompressionFormat::Gzip) {
+		// blocks are independent, each one is compressed in parallel
+		auto pDictionary = _pDictionary;
+		block = std::async(std::launch::async, [pInput, pDictionary, isLast]() {
+			return _deflateBlock(*pInput, pDictionary.get(), isLast);
+		}).share();
+
+		size_t dictionarySize = std::min(pInput->size(), _dictionarySize);
+		_pDictionary = std::make_shared<std::vector<char>>(pInput->end() - dictionarySize, pInput->end());
+	}
+	else {
+		// the encoder state is shared, each block waits for its predecessor
+		std::shared_future<block_t> previous = _blocks.empty() ? std::shared_future<block_t>() : _blocks.back();
+		void* pEncoder = _pBrotliEncoder;
+		block = std::async(std::launch::async, [pInput, previous, pEncoder, isLast]() {
+			if (previous.valid()) {
+				previous.wait();
+			}
+			return _brotliBlock(pEncoder, *pInput, isLast);
+		}).share();
+	}
+
+	_blocks.push_back(block);
+
+	// limit the memory held by pending blocks
+	size_t maxPendingBlocks = _format == CompressionFormat::Gzip ? parallelThreadCount() * 2 : 2;
+	while (_blocks.size() > maxPendingBlocks) {
+		_writeBlock();
+	}
+}
+
+void CompressedFile::_writeBlock()
+{
+	const block_t& block = _blocks.front().get();
+
+	if (!block.ok) {
+		_failed = true;
+	}
+	else if (!_failed && !_file.write(block.data.data(), block.data.size())) {
+		_failed = true;
+	}
+
+#if defined(MESHSMITH_HAS_ZLIB)
+	if (_format == CompressionFormat::Gzip) {
+		_crc = crc32_combine(_crc, block.crc, z_off_t(block.byteLength));
+	}
+#endif
+
+	_byteLength += block.byteLength;
+	_blocks.pop_front();
+}
+
+CompressedFile::block_t CompressedFile::_deflateBlock(const std::vector<char>& input, const std::vector<char>* pDictionary, bool isLast)
+{
+	block_t block;
+	block.byteLength = input.size();
+	block.crc = 0;
+	block.ok = false;
+
+#if defined(MESHSMITH_HAS_ZLIB)
+	block.crc = crc32(crc32(0, Z_NULL, 0), (const Bytef*)input.data(), uInt(input.size()));
+
+	// raw deflate, the gzip header and trailer are written by the file
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, _gzipLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return block;
+	}
+
+	if (pDictionary && !pDictionary->empty()) {
+		deflateSetDictionary(&stream, (const Bytef*)pDictionary->data(), uInt(pDictionary->size()));
+	}
+
+	// a sync flush ends a block on a byte boundary, so the compressed blocks can be concatenated
+	int flush = isLast ? Z_FINISH : Z_SYNC_FLUSH;
+	block.data.resize(deflateBound(&stream, uLong(input.size())) + 16);
+
+	stream.next_in = (Bytef*)input.data();
+	stream.avail_in = uInt(input.size());
+	stream.next_out = (Bytef*)block.data.data();
+	stream.avail_out = uInt(block.data.size());
+
+	int status = Z_OK;
+	while (true) {
+		status = deflate(&stream, flush);
+		if (status == Z_STREAM_ERROR || status == Z_STREAM_END || (stream.avail_in == 0 && stream.avail_out > 0)) {
+			break;
+		}
+
+		size_t written = block.data.size() - stream.avail_out;
+		block.data.resize(block.data.size() * 2);
+		stream.next_out = (Bytef*)block.data.data() + written;
+		stream.avail_out = uInt(block.data.size() - written);
+	}
+
+	block.data.resize(block.data.size() - stream.avail_out);
+	block.ok = status != Z_STREAM_ERROR && (!isLast || status == Z_STREAM_END);
+	deflateEnd(&stream);
+#endif
+
+	return block;
+}
+
+CompressedFile::block_t CompressedFile::_brotliBlock(void* pEncoder, const std::vector<char>& input, bool isLast)
+{
+	block_t block;
+	block.byteLength = input.size();
+	block.crc = 0;
+	block.ok = false;
+
+#if defined(MESHSMITH_HAS_BROTLI)
+	BrotliEncoderState* pState = (BrotliEncoderState*)pEncoder;
+	BrotliEncoderOperation operation = isLast ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+
+	const uint8_t* pNextIn = (const uint8_t*)input.data();
+	size_t availableIn = input.size();
+
+	while (availableIn > 0 || BrotliEncoderHasMoreOutput(pState) || (isLast && !BrotliEncoderIsFinished(pState))) {
+		size_t availableOut = 0;
+		if (!BrotliEncoderCompressStream(pState, operation, &availableIn, &pNextIn, &availableOut, nullptr, nullptr)) {
+			return block;
+		}
+
+		size_t outputSize = 0;
+		const uint8_t* pOutput = BrotliEncoderTakeOutput(pState, &outputSize);
+		block.data.insert(block.data.end(), (const char*)pOutput, (const char*)pOutput + outputSize);
+	}
+
+	block.ok = true;
+#endif
+
+	return block;
+}
@@ -0,0 +1,105 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_COMPRESSEDFILE_H
+#define _MESHSMITH_COMPRESSEDFILE_H
+
+#include "library.h"
+#include "OutputFile.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+
+namespace meshsmith
+{
+	enum class CompressionFormat { Gzip, Brotli };
+
+	/// Compressed copies written next to output files, for servers delivering precompressed content.
+	enum class Precompression { None, Gzip, Brotli, GzipBrotli };
+
+	/// Returns the compression formats of the given precompression setting.
+	MESHSMITH_CORE_EXPORT std::vector<CompressionFormat> precompressionFormats(Precompression precompression);
+
+	/// Output file compressed with gzip or brotli. Data is collected in blocks which are
+	/// compressed on worker threads while the caller continues writing. Gzip blocks are
+	/// compressed in parallel (deflate primed with the preceding 32KB as dictionary,
+	/// checksums combined afterwards). A brotli stream can't be split, its blocks are
+	/// compressed in order on a worker thread.
+	class MESHSMITH_CORE_EXPORT CompressedFile
+	{
+	public:
+		CompressedFile();
+		~CompressedFile();
+
+		CompressedFile(const CompressedFile& other) = delete;
+		CompressedFile& operator=(const CompressedFile& other) = delete;
+
+		/// Returns true if the format is supported by this build.
+		static bool isAvailable(CompressionFormat format);
+		/// Returns an error if a format of the given precompression setting isn't supported.
+		static flow::Result checkAvailable(Precompression precompression);
+		/// Returns the file extension for the format including the dot: .gz or .br
+		static std::string fileExtension(CompressionFormat format);
+		/// Writes a compressed copy of an existing file next to it.
+		static bool compressFile(const std::string& filePath, CompressionFormat format);
+
+	public:
+		/// Creates or truncates the file with the given path. Returns false on failure.
+		bool open(const std::string& filePath, CompressionFormat format);
+		/// Completes the compressed stream and closes the file. Returns false if any step failed.
+		bool close();
+
+		/// Compresses the given data. The data is copied, the memory can be reused after the call.
+		void write(const void* pData, size_t byteLength);
+
+		bool isOpen() const { return _file.isOpen(); }
+		const std::string& filePath() const { return _file.filePath(); }
+
+	private:
+		struct block_t
+		{
+			std::vector<char> data;
+			unsigned long crc;
+			size_t byteLength;
+			bool ok;
+		};
+
+		void _submitBlock(bool isLast);
+		void _writeBlock();
+
+		static block_t _deflateBlock(const std::vector<char>& input, const std::vector<char>* pDictionary, bool isLast);
+		static block_t _brotliBlock(void* pEncoder, const std::vector<char>& input, bool isLast);
+
+		OutputFile _file;
+		CompressionFormat _format;
+		bool _failed;
+
+		std::vector<char> _input;
+		std::shared_ptr<std::vector<char>> _pDictionary;
+		std::deque<std::shared_future<block_t>> _blocks;
+		unsigned long _crc;
+		uint64_t _byteLength;
+		void* _pBrotliEncoder;
+	};
+}
+
+#endif // _MESHSMITH_COMPRESSEDFILE_H
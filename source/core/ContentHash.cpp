@@ -0,0 +1,258 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ContentHash.h"
+#include "MappedFile.h"
+#include "path.h"
+
+#include "core/json.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+
+using namespace meshsmith;
+using namespace flow;
+
+static const uint64_t _prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t _prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t _prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t _prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t _prime5 = 0x27D4EB2F165667C5ULL;
+
+// version of the cache file format
+static const int _cacheVersion = 1;
+
+static inline uint64_t _rotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// unaligned little-endian reads
+static inline uint64_t _read64(const uint8_t* pData)
+{
+	uint64_t value;
+	memcpy(&value, pData, sizeof(value));
+	return value;
+}
+
+static inline uint32_t _read32(const uint8_t* pData)
+{
+	uint32_t value;
+	memcpy(&value, pData, sizeof(value));
+	return value;
+}
+
+static inline uint64_t _round(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * _prime2;
+	return _rotateLeft(accumulator, 31) * _prime1;
+}
+
+static inline uint64_t _mergeRound(uint64_t accumulator, uint64_t value)
+{
+	accumulator ^= _round(0, value);
+	return accumulator * _prime1 + _prime4;
+}
+
+/// Returns false if the file doesn't exist.
+static bool _fileStatus(const std::string& filePath, uint64_t& size, int64_t& modified)
+{
+#if defined(_WIN32)
+	struct _stati64 status;
+	if (_wstati64(path(filePath).wstr().c_str(), &status) != 0) {
+		return false;
+	}
+#else
+	struct stat status;
+	if (stat(filePath.c_str(), &status) != 0) {
+		return false;
+	}
+#endif
+
+	size = uint64_t(status.st_size);
+	modified = int64_t(status.st_mtime);
+	return true;
+}
+
+uint64_t meshsmith::xxHash64(const void* pData, size_t byteLength, uint64_t seed)
+{
+	const uint8_t* p = (const uint8_t*)pData;
+	const uint8_t* pEnd = p + byteLength;
+	uint64_t hash;
+
+	if (byteLength >= 32) {
+		// four independent lanes over 32 byte stripes
+		uint64_t v1 = seed + _prime1 + _prime2;
+		uint64_t v2 = seed + _prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - _prime1;
+
+		for (const uint8_t* pLimit = pEnd - 32; p <= pLimit; p += 32) {
+			v1 = _round(v1, _read64(p));
+			v2 = _round(v2, _read64(p + 8));
+			v3 = _round(v3, _read64(p + 16));
+			v4 = _round(v4, _read64(p + 24));
+		}
+
+		hash = _rotateLeft(v1, 1) + _rotateLeft(v2, 7) + _rotateLeft(v3, 12) + _rotateLeft(v4, 18);
+		hash = _mergeRound(hash, v1);
+		hash = _mergeRound(hash, v2);
+		hash = _mergeRound(hash, v3);
+		hash = _mergeRound(hash, v4);
+	}
+	else {
+		hash = seed + _prime5;
+	}
+
+	hash += uint64_t(byteLength);
+
+	for (; p + 8 <= pEnd; p += 8) {
+		hash ^= _round(0, _read64(p));
+		hash = _rotateLeft(hash, 27) * _prime1 + _prime4;
+	}
+	if (p + 4 <= pEnd) {
+		hash ^= uint64_t(_read32(p)) * _prime1;
+		hash = _rotateLeft(hash, 23) * _prime2 + _prime3;
+		p += 4;
+	}
+	for (; p < pEnd; ++p) {
+		hash ^= (*p) * _prime5;
+		hash = _rotateLeft(hash, 11) * _prime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= _prime2;
+	hash ^= hash >> 29;
+	hash *= _prime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ContentHashCache::ContentHashCache() :
+	_isModified(false)
+{
+}
+
+Result ContentHashCache::load(const std::string& cacheFile)
+{
+	std::ifstream stream(cacheFile);
+	if (!stream.is_open()) {
+		return Result::ok();
+	}
+
+	json jsonCache;
+
+	try {
+		stream >> jsonCache;
+	}
+	catch (const std::exception& e) {
+		return Result::error("failed to parse hash cache: " + cacheFile + ", reason: " + e.what());
+	}
+
+	// a cache of another version is rebuilt
+	if (!jsonCache.count("version") || jsonCache["version"] != _cacheVersion || !jsonCache.count("files")) {
+		return Result::ok();
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const json& jsonFiles = jsonCache["files"];
+	for (auto it = jsonFiles.begin(); it != jsonFiles.end(); ++it) {
+		const json& jsonEntry = it.value();
+		entry_t entry;
+		entry.size = jsonEntry.at("size").get<uint64_t>();
+		entry.modified = jsonEntry.at("modified").get<int64_t>();
+		entry.hash = std::stoull(jsonEntry.at("hash").get<std::string>(), nullptr, 16);
+		_entries[it.key()] = entry;
+	}
+
+	return Result::ok();
+}
+
+Result ContentHashCache::save(const std::string& cacheFile) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (!_isModified) {
+		return Result::ok();
+	}
+
+	json jsonFiles = json::object();
+	for (const auto& it : _entries) {
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)it.second.hash);
+		jsonFiles[it.first] = {
+			{ "size", it.second.size },
+			{ "modified", it.second.modified },
+			{ "hash", hash }
+		};
+	}
+
+	json jsonCache = {
+		{ "version", _cacheVersion },
+		{ "files", jsonFiles }
+	};
+
+	std::ofstream stream(cacheFile);
+	stream << jsonCache.dump(1, '\t');
+	if (!stream.good()) {
+		return Result::error("failed to write hash cache: " + cacheFile);
+	}
+
+	return Result::ok();
+}
+
+ResultT<uint64_t> ContentHashCache::fileHash(const std::string& filePath)
+{
+	entry_t entry;
+	if (!_fileStatus(filePath, entry.size, entry.modified)) {
+		return Result::error("file not found: " + filePath);
+	}
+
+	std::string key = path(filePath).make_absolute().str();
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _entries.find(key);
+		if (it != _entries.end() && it->second.size == entry.size && it->second.modified == entry.modified) {
+			return ResultT<uint64_t>(it->second.hash);
+		}
+	}
+
+	// the file is hashed without holding the lock, files can be hashed in parallel
+	if (entry.size == 0) {
+		entry.hash = xxHash64(nullptr, 0);
+	}
+	else {
+		MappedFile file;
+		if (!file.open(filePath)) {
+			return Result::error("failed to read file: " + filePath);
+		}
+		entry.hash = xxHash64(file.data(), file.size());
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entries[key] = entry;
+	_isModified = true;
+
+	return ResultT<uint64_t>(entry.hash);
+}
@@ -0,0 +1,65 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_CONTENTHASH_H
+#define _MESHSMITH_CONTENTHASH_H
+
+#include "library.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+namespace meshsmith
+{
+	/// 64 bit xxHash (XXH64) of a block of memory.
+	MESHSMITH_CORE_EXPORT uint64_t xxHash64(const void* pData, size_t byteLength, uint64_t seed = 0);
+
+	/// Content hashes of files, cached by path, size and modification time. The cache can be
+	/// stored in a JSON file shared by consecutive jobs, so unchanged files aren't read again.
+	/// Thread safe.
+	class MESHSMITH_CORE_EXPORT ContentHashCache
+	{
+	public:
+		ContentHashCache();
+
+		/// Reads the cache from the given file, a missing file is not an error.
+		flow::Result load(const std::string& cacheFile);
+		/// Writes the cache to the given file if new hashes were computed.
+		flow::Result save(const std::string& cacheFile) const;
+
+		/// Returns the hash of the file's content, reads the file if it isn't cached or has changed.
+		flow::ResultT<uint64_t> fileHash(const std::string& filePath);
+
+	private:
+		struct entry_t
+		{
+			uint64_t size;
+			int64_t modified;
+			uint64_t hash;
+		};
+
+		std::map<std::string, entry_t> _entries;
+		bool _isModified;
+		mutable std::mutex _mutex;
+	};
+}
+
+#endif // _MESHSMITH_CONTENTHASH_H
@@ -16,6 +16,10 @@
  */
 
 #include "GLTFExporter.h"
+#include "BinaryBuffer.h"
+#include "OutputFile.h"
+#include "Image.h"
+#include "ContentHash.h"
 
 #include "gltf/gltf.h"
 #include "gltf/GLTFDracoExtension.h"
@@ -28,13 +32,25 @@
 
 #pragma warning(push)
 #pragma warning(disable:4267)
+#include "draco/point_cloud/point_cloud.h"
 #include "draco/mesh/mesh.h"
 #include "draco/compression/encode.h"
 #include "draco/compression/decode.h"
 #pragma warning(pop)
 
+#include <algorithm>
 #include <iostream>
-
+#include <fstream>
+#include <limits>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "Processor.h"
+#include "parallel.h"
+#include "octahedral.h"
 #include "path.h"
 #ifdef max
 #undef max
@@ -51,16 +67,238 @@ using std::endl;
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static GLTFMimeType _mimeTypeFromExtension(const std::string& filePath)
+static string _mimeTypeFromExtension(const std::string& filePath)
 {
 	size_t dotPos = filePath.find_last_of('.');
 	string extenstion = filePath.substr(dotPos + 1);
 
 	if (extenstion == "png" || extenstion == "PNG") {
-		return GLTFMimeType::IMAGE_PNG;
+		return "image/png";
+	}
+	if (extenstion == "ktx2") {
+		return "image/ktx2";
+	}
+	if (extenstion == "webp") {
+		return "image/webp";
+	}
+
+	return "image/jpeg";
+}
+
+// default maximum buffer size, leaves room for the GLB header and JSON chunk within 4GB
+static const size_t _defaultMaxBufferSize = 0xffffffff - 0x1000000;
+
+// view priorities of the progressive layout: geometry needed for a first render and small
+// textures are placed first, followed by the remaining vertex attributes and large textures
+static const int _priorityFirstRender = -1;
+static const int _priorityDetail = 1;
+static const size_t _maxSmallTextureSize = 256 * 1024;
+
+// alignment of the stages of the progressive layout, matches typical HTTP range and page sizes
+static const size_t _progressiveStageAlignment = 4096;
+
+// smallest mipmap level written, viewers generate smaller levels faster than they download them
+static const size_t _minMipmapSize = 64;
+
+// maximum width and height of WebP images
+static const size_t _maxWebPSize = 16383;
+
+/// Returns the file name suffix of the buffer with the given index: .bin, _1.bin, _2.bin, ...
+/// or _<group>.bin, _<group>_1.bin, ... for buffers holding a group of views.
+static string _bufferFileSuffix(const BinaryBuffer* pBuffer, size_t bufferIndex)
+{
+	string group = pBuffer->bufferGroup(bufferIndex);
+	if (group.empty()) {
+		return bufferIndex == 0 ? string(".bin") : "_" + std::to_string(bufferIndex) + ".bin";
+	}
+
+	size_t part = 0;
+	for (size_t i = 0; i < bufferIndex; ++i) {
+		if (pBuffer->bufferGroup(i) == group) {
+			part++;
+		}
+	}
+
+	return "_" + group + (part > 0 ? "_" + std::to_string(part) : string()) + ".bin";
+}
+
+// maximum number of vertices in a chunk of a split mesh, index 65535 is reserved in glTF
+static const uint32_t _maxChunkVertices = 0xffff;
+
+/// Spreads the lower 10 bits of v so there are two zero bits between each bit.
+static uint32_t _mortonExpandBits(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// lower bounds of the quantization bits chosen by automatic tuning
+static const int _minPositionQuantizationBits = 6;
+static const int _minAttributeQuantizationBits = 4;
+
+static const float _degreesPerRadian = float(180.0 / 3.14159265358979323846);
+
+/// Returns the largest error introduced by Draco's quantization of a float attribute for each
+/// number of bits from minBits to maxBits. Draco uses a uniform grid spanning the largest extent
+/// of the attribute's values. Relative errors are divided by that extent.
+static std::vector<float> _dracoQuantizationErrors(
+	const draco::PointAttribute& attribute, int minBits, int maxBits, bool relative)
+{
+	size_t numValues = attribute.size();
+	size_t numComponents = size_t(attribute.num_components());
+	auto valueAt = [&attribute](size_t index) {
+		return (const float*)attribute.GetAddress(draco::AttributeValueIndex(uint32_t(index)));
+	};
+
+	std::vector<float> lowerBound(numComponents, std::numeric_limits<float>::max());
+	std::vector<float> upperBound(numComponents, std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < numValues; ++i) {
+		const float* p = valueAt(i);
+		for (size_t c = 0; c < numComponents; ++c) {
+			lowerBound[c] = flow::min(lowerBound[c], p[c]);
+			upperBound[c] = flow::max(upperBound[c], p[c]);
+		}
+	}
+
+	float range = 0.0f;
+	for (size_t c = 0; c < numComponents; ++c) {
+		range = flow::max(range, upperBound[c] - lowerBound[c]);
+	}
+	if (range <= 0.0f) {
+		range = 1.0f;
+	}
+
+	size_t numDepths = size_t(maxBits - minBits + 1);
+	std::vector<float> maxSquaredErrors(numDepths, 0.0f);
+	std::mutex mutex;
+
+	parallelFor(0, numValues, [&](size_t first, size_t last) {
+		std::vector<float> blockMax(numDepths, 0.0f);
+		for (size_t k = 0; k < numDepths; ++k) {
+			float maxQuantizedValue = float((1 << (minBits + int(k))) - 1);
+			float inverseDelta = maxQuantizedValue / range;
+			float delta = range / maxQuantizedValue;
+
+			for (size_t i = first; i < last; ++i) {
+				const float* p = valueAt(i);
+				float squaredError = 0.0f;
+				for (size_t c = 0; c < numComponents; ++c) {
+					float value = p[c] - lowerBound[c];
+					float d = std::floor(value * inverseDelta + 0.5f) * delta - value;
+					squaredError += d * d;
+				}
+				blockMax[k] = flow::max(blockMax[k], squaredError);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t k = 0; k < numDepths; ++k) {
+			maxSquaredErrors[k] = flow::max(maxSquaredErrors[k], blockMax[k]);
+		}
+	});
+
+	std::vector<float> errors(numDepths);
+	for (size_t k = 0; k < numDepths; ++k) {
+		errors[k] = std::sqrt(maxSquaredErrors[k]) / (relative ? range : 1.0f);
+	}
+
+	return errors;
+}
+
+/// Returns the largest angle in degrees between a normal and its quantized value for each number
+/// of bits from minBits to maxBits. Like Draco's octahedral quantization, the normal is scaled to
+/// an L1 norm of half the largest quantized value, two coordinates are rounded and the third one
+/// follows from the norm.
+static std::vector<float> _dracoNormalQuantizationErrors(const draco::PointAttribute& attribute, int minBits, int maxBits)
+{
+	size_t numValues = attribute.size();
+	size_t numDepths = size_t(maxBits - minBits + 1);
+	std::vector<float> maxAngles(numDepths, 0.0f);
+	std::mutex mutex;
+
+	parallelFor(0, numValues, [&](size_t first, size_t last) {
+		std::vector<float> blockMax(numDepths, 0.0f);
+		for (size_t k = 0; k < numDepths; ++k) {
+			float center = float(((1 << (minBits + int(k))) - 1) / 2);
+
+			for (size_t i = first; i < last; ++i) {
+				const float* n = (const float*)attribute.GetAddress(draco::AttributeValueIndex(uint32_t(i)));
+				float absSum = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+				if (absSum <= 0.0f) {
+					continue;
+				}
+
+				float x = std::floor(n[0] / absSum * center + 0.5f);
+				float y = std::floor(n[1] / absSum * center + 0.5f);
+				float z = center - std::fabs(x) - std::fabs(y);
+				if (z < 0.0f) {
+					// rounding overshoots the norm, the larger coordinate gives way
+					float& larger = std::fabs(x) > std::fabs(y) ? x : y;
+					larger -= std::copysign(-z, larger);
+					z = 0.0f;
+				}
+				z = std::copysign(z, n[2]);
+
+				float crossX = n[1] * z - n[2] * y;
+				float crossY = n[2] * x - n[0] * z;
+				float crossZ = n[0] * y - n[1] * x;
+				float cross = std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ);
+				float dot = n[0] * x + n[1] * y + n[2] * z;
+				blockMax[k] = flow::max(blockMax[k], std::atan2(cross, dot));
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t k = 0; k < numDepths; ++k) {
+			maxAngles[k] = flow::max(maxAngles[k], blockMax[k]);
+		}
+	});
+
+	for (auto& angle : maxAngles) {
+		angle *= _degreesPerRadian;
 	}
 
-	return GLTFMimeType::IMAGE_JPEG;
+	return maxAngles;
+}
+
+/// Meshes without faces or consisting of point primitives only are exported as point clouds.
+static bool _isPointCloud(const aiMesh* pMesh)
+{
+	return !pMesh->HasFaces() || pMesh->mPrimitiveTypes == uint32_t(aiPrimitiveType_POINT);
+}
+
+static draco::Status _dracoEncode(draco::Encoder& encoder,
+	const draco::PointCloud& dracoGeometry, bool isPointCloud, draco::EncoderBuffer* pEncoderBuffer)
+{
+	if (isPointCloud) {
+		return encoder.EncodePointCloudToBuffer(dracoGeometry, pEncoderBuffer);
+	}
+
+	return encoder.EncodeMeshToBuffer(static_cast<const draco::Mesh&>(dracoGeometry), pEncoderBuffer);
+}
+
+static int _dracoPredictionScheme(DracoPredictionScheme scheme)
+{
+	switch (scheme) {
+	case DracoPredictionScheme::None:
+		return draco::PREDICTION_NONE;
+	case DracoPredictionScheme::Difference:
+		return draco::PREDICTION_DIFFERENCE;
+	case DracoPredictionScheme::Parallelogram:
+		return draco::MESH_PREDICTION_PARALLELOGRAM;
+	case DracoPredictionScheme::MultiParallelogram:
+		// the constrained variant supersedes the original multi-parallelogram scheme
+		return draco::MESH_PREDICTION_CONSTRAINED_MULTI_PARALLELOGRAM;
+	case DracoPredictionScheme::TexCoordsPortable:
+		return draco::MESH_PREDICTION_TEX_COORDS_PORTABLE;
+	case DracoPredictionScheme::GeometricNormal:
+		return draco::MESH_PREDICTION_GEOMETRIC_NORMAL;
+	default:
+		return draco::PREDICTION_UNDEFINED;
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -78,8 +316,24 @@ void GLTFExporter::setOptions(const GLTFExporterOptions& options)
 	_options = options;
 }
 
+json GLTFExporter::getJsonReport() const
+{
+	return _report;
+}
+
 Result GLTFExporter::exportScene(const aiScene* pAiScene, const string& filePathName)
 {
+	_report = json::object();
+	_customAttributeRefs.clear();
+	_chunkMeshes.clear();
+	_accessorViewRefs.clear();
+	_textureViewRefs.clear();
+	_dracoViewRefs.clear();
+	_mapFileAliases.clear();
+	_mapSources.clear();
+	_mapTextures.clear();
+	_processedTextures.clear();
+	_textureImageRefs.clear();
 	path filePath(filePathName);
 
 	string fileName = filePath.filename();
@@ -90,17 +344,46 @@ Result GLTFExporter::exportScene(const aiScene* pAiScene, const string& filePath
 	if (numMeshes < 1) {
 		return Result::error("scene contains no meshes");
 	}
+	if (_options.meshIndex >= numMeshes) {
+		return Result::error("mesh index out of range: " + std::to_string(_options.meshIndex));
+	}
 
-	// for now, export first mesh
+	// all other meshes are left out, report them so they aren't dropped unnoticed
+	if (numMeshes > 1) {
+		_report["skippedMeshes"] = numMeshes - 1;
+		if (_options.verbose) {
+			cout << "Exporting mesh " << _options.meshIndex << ", skipping " << numMeshes - 1 << " other meshes" << endl;
+		}
+	}
+
+	Result precompressionResult = CompressedFile::checkAvailable(_options.precompression);
+	if (precompressionResult.isError()) {
+		return precompressionResult;
+	}
+
+	// for now, export a single mesh
 	GLTFAsset asset;
 	asset.setGenerator("MeshSmith mesh conversion tool");
 
-	GLTFBuffer* pBuffer = asset.createBuffer();
+	// buffer views are written directly from their sources after the asset is complete
+	BinaryBuffer buffer;
+	BinaryBuffer* pBuffer = &buffer;
+
+	// maps are hashed, processed and read while the geometry is encoded, they use no shared state
+	string outputDir = filePath.parent_path().str();
+	std::future<Result> mapFuture = std::async(std::launch::async, [this, outputDir]() {
+		return _prepareMaps(outputDir);
+	});
+
+	auto meshResult = _exportMesh(pAiScene, _options.meshIndex, asset, pBuffer);
+	Result mapResult = mapFuture.get();
 
-	auto meshResult = _exportMesh(pAiScene, 0, asset, pBuffer);
 	if (meshResult.isError()) {
 		return meshResult;
 	}
+	if (mapResult.isError()) {
+		return mapResult;
+	}
 
 	auto pMesh = meshResult.value();
 
@@ -117,31 +400,286 @@ Result GLTFExporter::exportScene(const aiScene* pAiScene, const string& filePath
 	pScene->addNode(pNode);
 	asset.setMainScene(pScene);
 
+	string binaryBasePath = path(filePath.parent_path() / fileNameNoExt).str();
+
 	if (_options.writeBinary) {
 		string glbFileName = fileNameNoExt + ".glb";
 		string glbFilePath = path(filePath.parent_path() / glbFileName).str();
-		if (!asset.saveGLB(glbFilePath)) {
-			return Result::error("failed to write GLB file: " + glbFilePath);
+		return _saveGLB(asset, pBuffer, glbFilePath, binaryBasePath);
+	}
+
+	string gltfFilePath = path(filePath.parent_path() / (fileNameNoExt + ".gltf")).str();
+	return _saveGLTF(asset, pBuffer, gltfFilePath, binaryBasePath);
+}
+
+void GLTFExporter::_setAccessorView(const GLTFAccessor* pAccessor, const BinaryView* pView, size_t byteOffset)
+{
+	accessorViewRef_t ref;
+	ref.accessorIndex = pAccessor->index();
+	ref.viewIndex = pView->index();
+	ref.byteOffset = byteOffset;
+	_accessorViewRefs.push_back(ref);
+}
+
+json GLTFExporter::_assetToJSON(const GLTFAsset& asset, const BinaryBuffer* pBuffer, const std::vector<string>& bufferUris) const
+{
+	json jsonAsset = asset.toJSON();
+
+	// buffer views are laid out by BinaryBuffer, add them and reference them here
+	if (pBuffer->viewCount() > 0) {
+		json jsonBuffers = json::array();
+		for (size_t i = 0; i < pBuffer->bufferCount(); ++i) {
+			json jsonBuffer = { { "byteLength", pBuffer->byteLength(i) } };
+			if (!bufferUris[i].empty()) {
+				jsonBuffer["uri"] = bufferUris[i];
+			}
+			jsonBuffers.push_back(jsonBuffer);
 		}
+		jsonAsset["buffers"] = jsonBuffers;
+		jsonAsset["bufferViews"] = pBuffer->viewsToJSON();
+	}
 
-		return Result::ok();
+	for (const auto& ref : _accessorViewRefs) {
+		json& jsonAccessor = jsonAsset["accessors"][ref.accessorIndex];
+		jsonAccessor["bufferView"] = ref.viewIndex;
+		if (ref.byteOffset > 0) {
+			jsonAccessor["byteOffset"] = ref.byteOffset;
+		}
+	}
+
+	for (const auto& ref : _textureViewRefs) {
+		size_t imageIndex = jsonAsset["textures"][ref.textureIndex]["source"].get<size_t>();
+		json& jsonImage = jsonAsset["images"][imageIndex];
+		jsonImage.erase("uri");
+		jsonImage["bufferView"] = ref.viewIndex;
+		jsonImage["mimeType"] = ref.mimeType;
 	}
 
-	string binaryFileName = fileNameNoExt + ".bin";
-	string binaryFilePath = path(filePath.parent_path() / binaryFileName).str();
-	pBuffer->setUri(binaryFileName);
-	pBuffer->save(binaryFilePath);
+	// KTX2 and WebP images are referenced by extensions, without fallback the extension is required
+	std::vector<string> extensionsUsed;
+	std::vector<string> extensionsRequired;
 
-	string gltfFilePath = path(filePath.parent_path() / (fileNameNoExt + ".gltf")).str();
-	if (!asset.saveGLTF(gltfFilePath, 2)) {
-		return Result::error("failed to write glTF file: " + gltfFilePath);
+	for (const auto& ref : _textureImageRefs) {
+		json& jsonTexture = jsonAsset["textures"][ref.textureIndex];
+		size_t imageIndex = jsonTexture["source"].get<size_t>();
+
+		if (!ref.extension.empty() && ref.image.is_null()) {
+			jsonTexture["extensions"][ref.extension]["source"] = imageIndex;
+			jsonTexture.erase("source");
+			if (std::find(extensionsRequired.begin(), extensionsRequired.end(), ref.extension) == extensionsRequired.end()) {
+				extensionsRequired.push_back(ref.extension);
+			}
+		}
+		else if (!ref.extension.empty()) {
+			jsonAsset["images"].push_back(ref.image);
+			imageIndex = jsonAsset["images"].size() - 1;
+			jsonTexture["extensions"][ref.extension]["source"] = imageIndex;
+		}
+
+		if (!ref.extension.empty()
+				&& std::find(extensionsUsed.begin(), extensionsUsed.end(), ref.extension) == extensionsUsed.end()) {
+			extensionsUsed.push_back(ref.extension);
+		}
+
+		if (!ref.mipmaps.is_null()) {
+			jsonAsset["images"][imageIndex]["extras"]["mipmaps"] = ref.mipmaps;
+		}
+	}
+
+	for (const auto& extension : extensionsUsed) {
+		jsonAsset["extensionsUsed"].push_back(extension);
+	}
+	for (const auto& extension : extensionsRequired) {
+		jsonAsset["extensionsRequired"].push_back(extension);
+	}
+
+	for (const auto& ref : _dracoViewRefs) {
+		json& jsonPrimitive = jsonAsset["meshes"][ref.meshIndex]["primitives"][ref.primitiveIndex];
+		jsonPrimitive["extensions"]["KHR_draco_mesh_compression"]["bufferView"] = ref.viewIndex;
+	}
+
+	// custom attribute names can't be expressed with GLTFAttributeType, add them here
+	for (const auto& ref : _customAttributeRefs) {
+		json& jsonPrimitive = jsonAsset["meshes"][ref.meshIndex]["primitives"][ref.primitiveIndex];
+		jsonPrimitive["attributes"][ref.name] = ref.accessorIndex;
+		if (!ref.extras.empty()) {
+			jsonPrimitive["extras"].update(ref.extras);
+		}
+		if (ref.dracoId >= 0) {
+			jsonPrimitive["extensions"]["KHR_draco_mesh_compression"]["attributes"][ref.name] = ref.dracoId;
+		}
+	}
+
+	// byte ranges of the progressive stages, a viewer can start rendering once the first stage is loaded
+	if (_options.progressiveLayout && !pBuffer->stages().empty()) {
+		json jsonStages = json::array();
+		for (const auto& stage : pBuffer->stages()) {
+			jsonStages.push_back({
+				{ "buffer", stage.bufferIndex },
+				{ "byteOffset", stage.byteOffset },
+				{ "byteLength", stage.byteLength }
+			});
+		}
+		jsonAsset["asset"]["extras"]["progressiveStages"] = jsonStages;
+	}
+
+	return jsonAsset;
+}
+
+size_t GLTFExporter::_layoutBuffers(BinaryBuffer* pBuffer, bool separateGroups) const
+{
+	BinaryLayoutOptions layoutOptions;
+	layoutOptions.maxBufferSize = _options.maxBufferSize > 0 ? _options.maxBufferSize : _defaultMaxBufferSize;
+	layoutOptions.separateGroups = separateGroups;
+	layoutOptions.orderByPriority = _options.progressiveLayout;
+	layoutOptions.stageAlignment = _progressiveStageAlignment;
+
+	size_t numBuffers = pBuffer->layout(layoutOptions);
+
+	if (_options.verbose && numBuffers > 1) {
+		cout << "Binary data split into " << numBuffers << " buffers" << endl;
+	}
+
+	return numBuffers;
+}
+
+Result GLTFExporter::_writeBuffers(const BinaryBuffer* pBuffer, size_t firstBuffer, const string& binaryBasePath) const
+{
+	// each buffer is an independent file, write them in parallel
+	std::vector<std::future<Result>> writers;
+
+	for (size_t i = firstBuffer; i < pBuffer->bufferCount(); ++i) {
+		string filePath = binaryBasePath + _bufferFileSuffix(pBuffer, i);
+		Precompression precompression = _options.precompression;
+		writers.push_back(std::async(std::launch::async, [pBuffer, i, filePath, precompression]() {
+			OutputFile file;
+			if (!file.open(filePath, precompression)) {
+				return Result::error("failed to write binary file: " + filePath);
+			}
+
+			Result result = pBuffer->write(file, i);
+			if (result.isError()) {
+				return result;
+			}
+
+			if (!file.close()) {
+				return Result::error("failed to write binary file: " + filePath);
+			}
+
+			return Result::ok();
+		}));
+	}
+
+	Result result = Result::ok();
+	for (auto& writer : writers) {
+		Result writerResult = writer.get();
+		if (writerResult.isError() && !result.isError()) {
+			result = writerResult;
+		}
+	}
+
+	return result;
+}
+
+Result GLTFExporter::_saveGLB(const GLTFAsset& asset, BinaryBuffer* pBuffer,
+	const string& filePath, const string& binaryBasePath) const
+{
+	// the layout must be known before the JSON chunk can be written,
+	// the first buffer is stored in the binary chunk, all others in .bin files
+	size_t numBuffers = _layoutBuffers(pBuffer, false);
+	size_t binaryLength = pBuffer->byteLength(0);
+
+	std::vector<string> bufferUris(numBuffers);
+	for (size_t i = 1; i < numBuffers; ++i) {
+		bufferUris[i] = path(binaryBasePath + _bufferFileSuffix(pBuffer, i)).filename();
+	}
+
+	// JSON chunk is padded with spaces, binary chunk with zeros to 4 byte boundaries
+	string jsonText = _assetToJSON(asset, pBuffer, bufferUris).dump();
+	jsonText.append((4 - jsonText.size() % 4) % 4, ' ');
+
+	size_t totalLength = 12 + 8 + jsonText.size() + (binaryLength > 0 ? 8 + binaryLength : 0);
+
+	if (totalLength > std::numeric_limits<uint32_t>::max()) {
+		return Result::error("GLB file exceeds 4GB limit, reduce maxBufferSize: " + filePath);
+	}
+
+	// external buffers are written while the GLB file is written
+	auto externalWriter = std::async(std::launch::async, [this, pBuffer, binaryBasePath]() {
+		return _writeBuffers(pBuffer, 1, binaryBasePath);
+	});
+
+	Result result = _writeGLB(pBuffer, filePath, jsonText, totalLength);
+	Result externalResult = externalWriter.get();
+
+	return result.isError() ? result : externalResult;
+}
+
+Result GLTFExporter::_writeGLB(const BinaryBuffer* pBuffer,
+	const string& filePath, const string& jsonText, size_t totalLength) const
+{
+	size_t binaryLength = pBuffer->byteLength(0);
+
+	OutputFile file;
+	if (!file.open(filePath, _options.precompression)) {
+		return Result::error("failed to write GLB file: " + filePath);
+	}
+
+	const uint32_t header[] = { 0x46546C67, 2, uint32_t(totalLength) }; // "glTF", version 2
+	const uint32_t jsonChunkHeader[] = { uint32_t(jsonText.size()), 0x4E4F534A }; // "JSON"
+	const uint32_t binaryChunkHeader[] = { uint32_t(binaryLength), 0x004E4942 }; // "BIN"
+
+	file.append(header, sizeof(header));
+	file.append(jsonChunkHeader, sizeof(jsonChunkHeader));
+	file.append(jsonText.data(), jsonText.size());
+
+	// buffer views are streamed from their sources, no contiguous copy of the binary chunk is made
+	if (binaryLength > 0) {
+		file.append(binaryChunkHeader, sizeof(binaryChunkHeader));
+
+		Result result = pBuffer->write(file, 0);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	if (!file.close()) {
+		return Result::error("failed to write GLB file: " + filePath);
+	}
+
+	return Result::ok();
+}
+
+Result GLTFExporter::_saveGLTF(const GLTFAsset& asset, BinaryBuffer* pBuffer,
+	const string& filePath, const string& binaryBasePath) const
+{
+	// with buffer grouping, each mesh or primitive gets its own .bin files
+	size_t numBuffers = _layoutBuffers(pBuffer, _options.bufferGrouping != BufferGrouping::None);
+
+	std::vector<string> bufferUris(numBuffers);
+	for (size_t i = 0; i < numBuffers; ++i) {
+		bufferUris[i] = path(binaryBasePath + _bufferFileSuffix(pBuffer, i)).filename();
+	}
+
+	if (pBuffer->viewCount() > 0) {
+		Result result = _writeBuffers(pBuffer, 0, binaryBasePath);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	string jsonText = _assetToJSON(asset, pBuffer, bufferUris).dump(2);
+
+	OutputFile file;
+	if (!file.open(filePath, _options.precompression) || !file.write(jsonText.data(), jsonText.size()) || !file.close()) {
+		return Result::error("failed to write glTF file: " + filePath);
 	}
 
 	return Result::ok();
 }
 
 ResultT<GLTFMesh*> GLTFExporter::_exportMesh(
-	const aiScene* pAiScene, size_t meshIndex, GLTFAsset& asset, GLTFBuffer* pBuffer)
+	const aiScene* pAiScene, size_t meshIndex, GLTFAsset& asset, BinaryBuffer* pBuffer)
 {
 	const aiMesh* pAiMesh = pAiScene->mMeshes[meshIndex];
 
@@ -149,8 +687,68 @@ ResultT<GLTFMesh*> GLTFExporter::_exportMesh(
 		return Result::error(string("mesh contains no positions: ") + pAiMesh->mName.C_Str());
 	}
 
+	Result attributesResult = _loadCustomAttributes(pAiMesh);
+	if (attributesResult.isError()) {
+		return attributesResult;
+	}
+
+	bool isPointCloud = _isPointCloud(pAiMesh);
+	if (_options.verbose && isPointCloud) {
+		cout << "Exporting point cloud: " << pAiMesh->mName.C_Str() << endl;
+	}
+
 	GLTFMesh* pMesh = asset.createMesh();
-	GLTFPrimitive& primitive = pMesh->createPrimitive(GLTFPrimitiveMode::TRIANGLES);
+	if (_options.bufferGrouping == BufferGrouping::Mesh) {
+		pBuffer->setGroup("mesh" + std::to_string(pMesh->index()));
+	}
+
+	// large meshes are split into chunks which can be indexed with 16 bit indices
+	bool split = _options.splitMeshes && !_options.useCompression && !isPointCloud
+		&& pAiMesh->mNumVertices > _maxChunkVertices;
+
+	if (!split) {
+		Result result = _exportPrimitive(pAiMesh, asset, pMesh, 0, pBuffer, nullptr);
+		if (result.isError()) {
+			return result;
+		}
+
+		return ResultT<GLTFMesh*>(pMesh);
+	}
+
+	std::vector<meshChunk_t> chunks;
+	Result splitResult = _splitMesh(pAiMesh, chunks);
+	if (splitResult.isError()) {
+		return splitResult;
+	}
+
+	if (_options.verbose) {
+		cout << "Mesh split into " << chunks.size() << " chunks" << endl;
+	}
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		Result result = _exportPrimitive(chunks[i].pMesh.get(), asset, pMesh, i, pBuffer, &chunks[i].vertexMap);
+		if (result.isError()) {
+			return result;
+		}
+
+		// buffer views reference the chunk's arrays until the buffer is written
+		_chunkMeshes.push_back(chunks[i].pMesh);
+	}
+
+	_report["splitMeshes"].push_back(chunks.size());
+
+	return ResultT<GLTFMesh*>(pMesh);
+}
+
+Result GLTFExporter::_exportPrimitive(const aiMesh* pAiMesh, GLTFAsset& asset,
+	GLTFMesh* pMesh, size_t primitiveIndex, BinaryBuffer* pBuffer, const std::vector<uint32_t>* pVertexMap)
+{
+	bool isPointCloud = _isPointCloud(pAiMesh);
+	if (_options.bufferGrouping == BufferGrouping::Primitive) {
+		pBuffer->setGroup("mesh" + std::to_string(pMesh->index()) + "_" + std::to_string(primitiveIndex));
+	}
+
+	GLTFPrimitive& primitive = pMesh->createPrimitive(isPointCloud ? GLTFPrimitiveMode::POINTS : GLTFPrimitiveMode::TRIANGLES);
 	size_t numVertices = pAiMesh->mNumVertices;
 
 	if (_options.useCompression) {
@@ -158,11 +756,17 @@ ResultT<GLTFMesh*> GLTFExporter::_exportMesh(
 		asset.addExtension(pDracoExtension, true);
 		primitive.addExtension(pDracoExtension);
 
-		Result result = _dracoCompressMesh(pAiMesh, pDracoExtension, pBuffer);
+		ResultT<BinaryView*> result = _dracoCompressMesh(pAiMesh, pDracoExtension, pBuffer);
 		if (result.isError()) {
 			return result;
 		}
 
+		dracoViewRef_t ref;
+		ref.meshIndex = pMesh->index();
+		ref.primitiveIndex = primitiveIndex;
+		ref.viewIndex = result.value()->index();
+		_dracoViewRefs.push_back(ref);
+
 		auto pAccPosition = asset.createAccessor<float>(GLTFAccessorType::VEC3);
 		pAccPosition->setElementCount(numVertices);
 		pAccPosition->updateBounds((float*)(pAiMesh->mVertices));
@@ -189,32 +793,72 @@ ResultT<GLTFMesh*> GLTFExporter::_exportMesh(
 			primitive.addAttribute(GLTFAttributeType::TEXCOORD_1, pAccUVs);
 		}
 
-		if (pAiMesh->HasFaces()) {
+		if (pAiMesh->HasVertexColors(0)) {
+			auto pAccColors = asset.createAccessor<float>(GLTFAccessorType::VEC4);
+			pAccColors->setElementCount(numVertices);
+			primitive.addAttribute(GLTFAttributeType::COLOR_0, pAccColors);
+		}
+
+		_exportCustomAttributes(pAiMesh, asset, pMesh, primitiveIndex, nullptr, pVertexMap);
+
+		if (!isPointCloud) {
 			auto pAccIndices = asset.createAccessor<uint32_t>(GLTFAccessorType::SCALAR);
 			pAccIndices->setElementCount(pAiMesh->mNumFaces * 3);
 			primitive.setIndices(pAccIndices);
 		}
 	}
 	else {
-		auto pAccPosition = asset.createAccessor<float>(GLTFAccessorType::VEC3);
-		pAccPosition->addVertexData(pBuffer, (float*)(pAiMesh->mVertices), numVertices);
-		pAccPosition->updateBounds();
-		primitive.addPositions(pAccPosition);
+		if (_options.interleaved) {
+			_exportInterleaved(pAiMesh, asset, primitive, pBuffer);
+		}
+		else {
+			// aiVector3D arrays match the glTF float VEC3 layout, the buffer references them directly
+			size_t v3fsize = sizeof(float) * 3;
+
+			auto pAccPosition = asset.createAccessor<float>(GLTFAccessorType::VEC3);
+			pAccPosition->setElementCount(numVertices);
+			pAccPosition->updateBounds((float*)(pAiMesh->mVertices));
+			BinaryView* pPositionView = pBuffer->addMemory(pAiMesh->mVertices, v3fsize * numVertices, ViewTarget::ArrayBuffer);
+			pPositionView->setPriority(_priorityFirstRender);
+			_setAccessorView(pAccPosition, pPositionView);
+			primitive.addPositions(pAccPosition);
+
+			if (pAiMesh->HasNormals() && !_options.stripNormals && _exportFloatNormals()) {
+				auto pAccNormals = asset.createAccessor<float>(GLTFAccessorType::VEC3);
+				pAccNormals->setElementCount(numVertices);
+				_setAccessorView(pAccNormals, pBuffer->addMemory(pAiMesh->mNormals, v3fsize * numVertices, ViewTarget::ArrayBuffer));
+				primitive.addNormals(pAccNormals);
+			}
 
-		if (pAiMesh->HasNormals() && !_options.stripNormals) {
-			auto pAccNormals = asset.createAccessor<float>(GLTFAccessorType::VEC3);
-			pAccNormals->addVertexData(pBuffer, (float*)(pAiMesh->mNormals), numVertices);
-			primitive.addNormals(pAccNormals);
+			if (pAiMesh->HasTextureCoords(0) && !_options.stripTexCoords) {
+				_exportTexCoords(pAiMesh, asset, primitive, pBuffer, 0);
+			}
+			if (pAiMesh->HasTextureCoords(1) && !_options.stripTexCoords) {
+				_exportTexCoords(pAiMesh, asset, primitive, pBuffer, 1);
+			}
 		}
 
-		if (pAiMesh->HasTextureCoords(0) && !_options.stripTexCoords) {
-			_exportTexCoords(pAiMesh, asset, primitive, pBuffer, 0);
+		if (pAiMesh->HasVertexColors(0)) {
+			if (_options.colorFormat == VertexColorFormat::UInt16) {
+				_exportColors<uint16_t>(pAiMesh, asset, primitive, pBuffer);
+			}
+			else {
+				_exportColors<uint8_t>(pAiMesh, asset, primitive, pBuffer);
+			}
 		}
-		if (pAiMesh->HasTextureCoords(1) && !_options.stripTexCoords) {
-			_exportTexCoords(pAiMesh, asset, primitive, pBuffer, 1);
+
+		if (pAiMesh->HasNormals() && !_options.stripNormals) {
+			if (_options.normalEncoding == NormalEncoding::Oct8) {
+				_exportOctahedral<int8_t>(pAiMesh, asset, pMesh, primitiveIndex, pBuffer);
+			}
+			else if (_options.normalEncoding == NormalEncoding::Oct16) {
+				_exportOctahedral<int16_t>(pAiMesh, asset, pMesh, primitiveIndex, pBuffer);
+			}
 		}
 
-		if (pAiMesh->HasFaces()) {
+		_exportCustomAttributes(pAiMesh, asset, pMesh, primitiveIndex, pBuffer, pVertexMap);
+
+		if (!isPointCloud) {
 			Result result = pAiMesh->mNumVertices <= 0xffff
 				? _exportFaces<uint16_t>(pAiMesh, asset, primitive, pBuffer)
 				: _exportFaces<uint32_t>(pAiMesh, asset, primitive, pBuffer);
@@ -225,67 +869,536 @@ ResultT<GLTFMesh*> GLTFExporter::_exportMesh(
 		}
 	}
 
-	return ResultT<GLTFMesh*>(pMesh);
+	return Result::ok();
 }
 
-template<typename T>
-Result GLTFExporter::_exportFaces(
-	const aiMesh* pAiMesh, GLTFAsset& asset, GLTFPrimitive& primitive, GLTFBuffer* pBuffer)
+Result GLTFExporter::_splitMesh(const aiMesh* pAiMesh, std::vector<meshChunk_t>& chunks) const
 {
 	size_t numFaces = pAiMesh->mNumFaces;
-
-	auto pAccIndices = asset.createAccessor<T>(GLTFAccessorType::SCALAR);
-	T* pDst = pAccIndices->allocateIndexData(pBuffer, numFaces * 3);
-	const aiFace* pSrc = pAiMesh->mFaces;
+	size_t numVertices = pAiMesh->mNumVertices;
+	const aiFace* pFaces = pAiMesh->mFaces;
 
 	for (size_t i = 0; i < numFaces; ++i) {
-		const aiFace& f = pSrc[i];
-		if (f.mNumIndices != 3) {
+		if (pFaces[i].mNumIndices != 3) {
 			return Result::error("mesh contains non triangular face");
 		}
-		pDst[i * 3] = f.mIndices[0];
-		pDst[i * 3 + 1] = f.mIndices[1];
-		pDst[i * 3 + 2] = f.mIndices[2];
 	}
 
-	pAccIndices->bufferView()->setTarget(GLTFBufferViewTarget::ELEMENT_ARRAY_BUFFER);
-	primitive.setIndices(pAccIndices);
+	// sort faces along a Morton curve through their centroids, keys are (code << 32 | face index)
+	Range3f boundingBox = Processor::calculateBoundingBox(pAiMesh);
+	Vector3f lowerBound = boundingBox.lowerBound();
+	Vector3f size = boundingBox.size();
+	float extent = flow::max(size.x, flow::max(size.y, size.z));
+	float scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+
+	std::vector<uint64_t> keys(numFaces);
+	parallelFor(0, numFaces, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			const unsigned int* pIndices = pFaces[i].mIndices;
+			uint32_t code = 0;
+			for (size_t c = 0; c < 3; ++c) {
+				float centroid = (pAiMesh->mVertices[pIndices[0]][c] + pAiMesh->mVertices[pIndices[1]][c]
+					+ pAiMesh->mVertices[pIndices[2]][c]) / 3.0f;
+				float cell = flow::min(flow::max((centroid - lowerBound[c]) * scale, 0.0f), 1023.0f);
+				code |= _mortonExpandBits(uint32_t(cell)) << c;
+			}
+			keys[i] = (uint64_t(code) << 32) | uint64_t(i);
+		}
+	});
 
-	return Result::ok();
-}
+	std::sort(keys.begin(), keys.end());
 
-void GLTFExporter::_exportTexCoords(
-	const aiMesh* pAiMesh, GLTFAsset& asset, GLTFPrimitive& primitive, GLTFBuffer* pBuffer, int channel)
-{
-	size_t numVertices = pAiMesh->mNumVertices;
-	size_t numComponents = pAiMesh->mNumUVComponents[channel];
-	GLTFAccessorT<float>* pAccUVs = nullptr;
+	// greedy partition: faces are added in curve order until the chunk's vertex budget is reached
+	const uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> localIndices(numVertices, unassigned);
+	std::vector<std::vector<uint32_t>> chunkIndices;
+	chunks.clear();
 
-	if (numComponents < 3) {
-		GLTFAccessorType accType = numComponents == 0 ? GLTFAccessorType::SCALAR : GLTFAccessorType::VEC2;
-		pAccUVs = asset.createAccessor<float>(accType);
-		const float* pSrc = (const float*)pAiMesh->mTextureCoords[channel];
-		float* pDst = pAccUVs->allocateVertexData(pBuffer, numVertices);
-		for (size_t i = 0; i < numVertices; ++i) {
-			pDst[i * numComponents] = pSrc[i * 3];
-		}
-		if (numComponents == 2) {
-			for (size_t i = 0; i < numVertices; ++i) {
-				pDst[i * numComponents + 1] = 1.0f - pSrc[i * 3 + 1];
+	for (size_t k = 0; k < numFaces; ++k) {
+		const unsigned int* pIndices = pFaces[uint32_t(keys[k])].mIndices;
+
+		size_t newVertices = 0;
+		for (size_t c = 0; c < 3; ++c) {
+			bool duplicate = (c > 0 && pIndices[c] == pIndices[0]) || (c > 1 && pIndices[c] == pIndices[1]);
+			if (localIndices[pIndices[c]] == unassigned && !duplicate) {
+				newVertices++;
 			}
 		}
+
+		if (chunks.empty() || chunks.back().vertexMap.size() + newVertices > _maxChunkVertices) {
+			if (!chunks.empty()) {
+				for (uint32_t vertexIndex : chunks.back().vertexMap) {
+					localIndices[vertexIndex] = unassigned;
+				}
+			}
+			chunks.push_back(meshChunk_t());
+			chunkIndices.push_back(std::vector<uint32_t>());
+		}
+
+		std::vector<uint32_t>& vertexMap = chunks.back().vertexMap;
+		for (size_t c = 0; c < 3; ++c) {
+			uint32_t& localIndex = localIndices[pIndices[c]];
+			if (localIndex == unassigned) {
+				localIndex = uint32_t(vertexMap.size());
+				vertexMap.push_back(pIndices[c]);
+			}
+			chunkIndices.back().push_back(localIndex);
+		}
+	}
+
+	// chunk meshes are assembled in parallel
+	parallelFor(0, chunks.size(), [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			const std::vector<uint32_t>& vertexMap = chunks[i].vertexMap;
+			const std::vector<uint32_t>& indices = chunkIndices[i];
+			size_t chunkVertices = vertexMap.size();
+			size_t chunkFaceCount = indices.size() / 3;
+
+			aiMesh* pChunk = new aiMesh();
+			chunks[i].pMesh.reset(pChunk);
+			pChunk->mName = pAiMesh->mName;
+			pChunk->mMaterialIndex = pAiMesh->mMaterialIndex;
+			pChunk->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+			pChunk->mNumVertices = uint32_t(chunkVertices);
+			pChunk->mNumFaces = uint32_t(chunkFaceCount);
+
+			auto copyVectors = [&vertexMap, chunkVertices](const aiVector3D* pSrc) {
+				aiVector3D* pDst = new aiVector3D[chunkVertices];
+				for (size_t v = 0; v < chunkVertices; ++v) {
+					pDst[v] = pSrc[vertexMap[v]];
+				}
+				return pDst;
+			};
+
+			pChunk->mVertices = copyVectors(pAiMesh->mVertices);
+			if (pAiMesh->HasNormals()) {
+				pChunk->mNormals = copyVectors(pAiMesh->mNormals);
+			}
+			if (pAiMesh->HasTangentsAndBitangents()) {
+				pChunk->mTangents = copyVectors(pAiMesh->mTangents);
+				pChunk->mBitangents = copyVectors(pAiMesh->mBitangents);
+			}
+			for (uint32_t c = 0; c < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++c) {
+				if (pAiMesh->HasTextureCoords(c)) {
+					pChunk->mTextureCoords[c] = copyVectors(pAiMesh->mTextureCoords[c]);
+					pChunk->mNumUVComponents[c] = pAiMesh->mNumUVComponents[c];
+				}
+			}
+			for (uint32_t c = 0; c < AI_MAX_NUMBER_OF_COLOR_SETS; ++c) {
+				if (pAiMesh->HasVertexColors(c)) {
+					pChunk->mColors[c] = new aiColor4D[chunkVertices];
+					for (size_t v = 0; v < chunkVertices; ++v) {
+						pChunk->mColors[c][v] = pAiMesh->mColors[c][vertexMap[v]];
+					}
+				}
+			}
+
+			pChunk->mFaces = new aiFace[chunkFaceCount];
+			for (size_t f = 0; f < chunkFaceCount; ++f) {
+				aiFace& face = pChunk->mFaces[f];
+				face.mNumIndices = 3;
+				face.mIndices = new unsigned int[3];
+				face.mIndices[0] = indices[f * 3];
+				face.mIndices[1] = indices[f * 3 + 1];
+				face.mIndices[2] = indices[f * 3 + 2];
+			}
+		}
+	}, 1);
+
+	return Result::ok();
+}
+
+template<typename T>
+Result GLTFExporter::_exportFaces(
+	const aiMesh* pAiMesh, GLTFAsset& asset, GLTFPrimitive& primitive, BinaryBuffer* pBuffer)
+{
+	size_t numFaces = pAiMesh->mNumFaces;
+	const aiFace* pSrc = pAiMesh->mFaces;
+
+	// faces are validated now, indices are generated when the buffer is written
+	for (size_t i = 0; i < numFaces; ++i) {
+		if (pSrc[i].mNumIndices != 3) {
+			return Result::error("mesh contains non triangular face");
+		}
+	}
+
+	auto pSource = std::make_shared<GeneratedSource>(numFaces, sizeof(T) * 3,
+		[pSrc](size_t first, size_t count, void* pData) {
+			T* pDst = (T*)pData;
+			for (size_t i = 0; i < count; ++i) {
+				const aiFace& f = pSrc[first + i];
+				pDst[i * 3] = T(f.mIndices[0]);
+				pDst[i * 3 + 1] = T(f.mIndices[1]);
+				pDst[i * 3 + 2] = T(f.mIndices[2]);
+			}
+		});
+
+	auto pAccIndices = asset.createAccessor<T>(GLTFAccessorType::SCALAR);
+	pAccIndices->setElementCount(numFaces * 3);
+	BinaryView* pView = pBuffer->addView(pSource, ViewTarget::ElementArrayBuffer);
+	pView->setPriority(_priorityFirstRender);
+	_setAccessorView(pAccIndices, pView);
+	primitive.setIndices(pAccIndices);
+
+	return Result::ok();
+}
+
+void GLTFExporter::_exportTexCoords(
+	const aiMesh* pAiMesh, GLTFAsset& asset, GLTFPrimitive& primitive, BinaryBuffer* pBuffer, int channel)
+{
+	size_t numVertices = pAiMesh->mNumVertices;
+	size_t numComponents = pAiMesh->mNumUVComponents[channel];
+	const float* pSrc = (const float*)pAiMesh->mTextureCoords[channel];
+	GLTFAccessorT<float>* pAccUVs = nullptr;
+	BinaryView* pView = nullptr;
+
+	if (numComponents < 3) {
+		// 1 or 2 component UVs are packed and flipped when the buffer is written
+		GLTFAccessorType accType = numComponents == 0 ? GLTFAccessorType::SCALAR : GLTFAccessorType::VEC2;
+		pAccUVs = asset.createAccessor<float>(accType);
+		size_t elementSize = flow::max(numComponents, size_t(1));
+
+		auto pSource = std::make_shared<GeneratedSource>(numVertices, elementSize * sizeof(float),
+			[pSrc, elementSize](size_t first, size_t count, void* pData) {
+				float* pDst = (float*)pData;
+				const float* pVertex = pSrc + first * 3;
+				for (size_t i = 0; i < count; ++i) {
+					pDst[i * elementSize] = pVertex[i * 3];
+				}
+				if (elementSize == 2) {
+					for (size_t i = 0; i < count; ++i) {
+						pDst[i * 2 + 1] = 1.0f - pVertex[i * 3 + 1];
+					}
+				}
+			});
+
+		pView = pBuffer->addView(pSource, ViewTarget::ArrayBuffer);
 	}
 	else {
 		pAccUVs = asset.createAccessor<float>(GLTFAccessorType::VEC3);
-		pAccUVs->addVertexData(pBuffer, (float*)(pAiMesh->mTextureCoords[channel]), numVertices);
+		pView = pBuffer->addMemory(pSrc, sizeof(float) * 3 * numVertices, ViewTarget::ArrayBuffer);
 	}
 
+	pAccUVs->setElementCount(numVertices);
+	_setAccessorView(pAccUVs, pView);
 	primitive.addTexCoords(pAccUVs);
 }
 
+void GLTFExporter::_exportInterleaved(
+	const aiMesh* pAiMesh, GLTFAsset& asset, GLTFPrimitive& primitive, BinaryBuffer* pBuffer)
+{
+	// attribute streams copied from Assimp's 3-component arrays into one element per vertex
+	struct stream_t
+	{
+		const float* pSrc;
+		size_t numComponents;
+		bool flipV;
+		size_t byteOffset;
+	};
+
+	size_t numVertices = pAiMesh->mNumVertices;
+	size_t byteStride = 0;
+	std::vector<stream_t> streams;
+
+	auto addStream = [&streams, &byteStride](const void* pSrc, size_t numComponents, bool flipV) {
+		stream_t stream = { (const float*)pSrc, numComponents, flipV, byteStride };
+		streams.push_back(stream);
+		byteStride += numComponents * sizeof(float);
+	};
+
+	bool hasNormals = pAiMesh->HasNormals() && !_options.stripNormals && _exportFloatNormals();
+	bool hasTexCoords[2] = {
+		pAiMesh->HasTextureCoords(0) && !_options.stripTexCoords,
+		pAiMesh->HasTextureCoords(1) && !_options.stripTexCoords
+	};
+
+	addStream(pAiMesh->mVertices, 3, false);
+	if (hasNormals) {
+		addStream(pAiMesh->mNormals, 3, false);
+	}
+	for (int channel = 0; channel < 2; ++channel) {
+		if (hasTexCoords[channel]) {
+			size_t numComponents = flow::min(flow::max(size_t(pAiMesh->mNumUVComponents[channel]), size_t(1)), size_t(3));
+			addStream(pAiMesh->mTextureCoords[channel], numComponents, numComponents == 2);
+		}
+	}
+
+	// vertices are interleaved in a single pass when the buffer is written
+	size_t numFloats = byteStride / sizeof(float);
+	auto pSource = std::make_shared<GeneratedSource>(numVertices, byteStride,
+		[streams, numFloats](size_t first, size_t count, void* pData) {
+			float* pDst = (float*)pData;
+			for (size_t i = 0; i < count; ++i) {
+				float* pVertex = pDst + i * numFloats;
+				for (const auto& stream : streams) {
+					const float* pSrc = stream.pSrc + (first + i) * 3;
+					float* pOut = pVertex + stream.byteOffset / sizeof(float);
+					for (size_t c = 0; c < stream.numComponents; ++c) {
+						pOut[c] = pSrc[c];
+					}
+					if (stream.flipV) {
+						pOut[1] = 1.0f - pSrc[1];
+					}
+				}
+			}
+		});
+
+	BinaryView* pView = pBuffer->addView(pSource, ViewTarget::ArrayBuffer);
+	pView->setPriority(_priorityFirstRender);
+	pView->setByteStride(byteStride);
+
+	static const GLTFAccessorType accessorTypes[] = {
+		GLTFAccessorType::SCALAR, GLTFAccessorType::VEC2, GLTFAccessorType::VEC3
+	};
+
+	auto streamIt = streams.begin();
+
+	auto pAccPosition = asset.createAccessor<float>(GLTFAccessorType::VEC3);
+	pAccPosition->setElementCount(numVertices);
+	pAccPosition->updateBounds((float*)(pAiMesh->mVertices));
+	_setAccessorView(pAccPosition, pView, (streamIt++)->byteOffset);
+	primitive.addPositions(pAccPosition);
+
+	if (hasNormals) {
+		auto pAccNormals = asset.createAccessor<float>(GLTFAccessorType::VEC3);
+		pAccNormals->setElementCount(numVertices);
+		_setAccessorView(pAccNormals, pView, (streamIt++)->byteOffset);
+		primitive.addNormals(pAccNormals);
+	}
+
+	for (int channel = 0; channel < 2; ++channel) {
+		if (hasTexCoords[channel]) {
+			auto pAccUVs = asset.createAccessor<float>(accessorTypes[streamIt->numComponents - 1]);
+			pAccUVs->setElementCount(numVertices);
+			_setAccessorView(pAccUVs, pView, (streamIt++)->byteOffset);
+			primitive.addTexCoords(pAccUVs);
+		}
+	}
+}
+
+template<typename T>
+void GLTFExporter::_exportColors(
+	const aiMesh* pAiMesh, GLTFAsset& asset, GLTFPrimitive& primitive, BinaryBuffer* pBuffer)
+{
+	size_t numVertices = pAiMesh->mNumVertices;
+	const float maxValue = float(std::numeric_limits<T>::max());
+	const float* pSrc = (const float*)pAiMesh->mColors[0];
+
+	// colors are converted to normalized integers when the buffer is written
+	auto pSource = std::make_shared<GeneratedSource>(numVertices, sizeof(T) * 4,
+		[pSrc, maxValue](size_t first, size_t count, void* pData) {
+			T* pDst = (T*)pData;
+			const float* pColors = pSrc + first * 4;
+			for (size_t i = 0; i < count * 4; ++i) {
+				float value = flow::min(flow::max(pColors[i], 0.0f), 1.0f);
+				pDst[i] = T(value * maxValue + 0.5f);
+			}
+		});
+
+	auto pAccColors = asset.createAccessor<T>(GLTFAccessorType::VEC4);
+	pAccColors->setNormalized(true);
+	pAccColors->setElementCount(numVertices);
+	_setAccessorView(pAccColors, pBuffer->addView(pSource, ViewTarget::ArrayBuffer));
+	primitive.addAttribute(GLTFAttributeType::COLOR_0, pAccColors);
+}
+
+bool GLTFExporter::_exportFloatNormals() const
+{
+	// octahedral normals are added to the standard ones, unless the viewer decodes them only
+	return _options.normalEncoding == NormalEncoding::Float || !_options.octNormalsOnly;
+}
+
+template<typename T>
+void GLTFExporter::_exportOctahedral(const aiMesh* pAiMesh,
+	GLTFAsset& asset, GLTFMesh* pMesh, size_t primitiveIndex, BinaryBuffer* pBuffer)
+{
+	size_t numVertices = pAiMesh->mNumVertices;
+	const float* pNormals = (const float*)pAiMesh->mNormals;
+	const char* encodingName = sizeof(T) == 1 ? "oct8" : "oct16";
+
+	// vertex attribute elements must be 4-byte aligned, 8 bit normals are padded
+	size_t normalStride = flow::max(2 * sizeof(T), size_t(4)) / sizeof(T);
+	auto pNormalSource = std::make_shared<GeneratedSource>(numVertices, normalStride * sizeof(T),
+		[pNormals, normalStride](size_t first, size_t count, void* pData) {
+			T* pDst = (T*)pData;
+			octahedralEncode(pNormals + first * 3, 3, count, pDst, normalStride);
+			for (size_t i = 0; i < count; ++i) {
+				for (size_t c = 2; c < normalStride; ++c) {
+					pDst[i * normalStride + c] = 0;
+				}
+			}
+		});
+
+	auto pAccNormals = asset.createAccessor<T>(GLTFAccessorType::VEC2);
+	pAccNormals->setNormalized(true);
+	pAccNormals->setElementCount(numVertices);
+	BinaryView* pNormalView = pBuffer->addView(pNormalSource, ViewTarget::ArrayBuffer);
+	if (normalStride * sizeof(T) > 2 * sizeof(T)) {
+		pNormalView->setByteStride(normalStride * sizeof(T));
+	}
+	_setAccessorView(pAccNormals, pNormalView);
+
+	customAttributeRef_t ref;
+	ref.meshIndex = pMesh->index();
+	ref.primitiveIndex = primitiveIndex;
+	ref.name = "_NORMAL_OCT";
+	ref.accessorIndex = pAccNormals->index();
+	ref.dracoId = -1;
+	ref.extras = { { "normalEncoding", encodingName } };
+	_customAttributeRefs.push_back(ref);
+
+	if (!pAiMesh->HasTangentsAndBitangents()) {
+		return;
+	}
+
+	// tangents: octahedral direction, handedness as third component (+/-1), fourth component unused
+	const float* pTangents = (const float*)pAiMesh->mTangents;
+	const float* pBitangents = (const float*)pAiMesh->mBitangents;
+	const T maxValue = std::numeric_limits<T>::max();
+
+	auto pTangentSource = std::make_shared<GeneratedSource>(numVertices, 4 * sizeof(T),
+		[pNormals, pTangents, pBitangents, maxValue](size_t first, size_t count, void* pData) {
+			T* pDst = (T*)pData;
+			octahedralEncode(pTangents + first * 3, 3, count, pDst, 4);
+			for (size_t i = 0; i < count; ++i) {
+				const float* n = pNormals + (first + i) * 3;
+				const float* t = pTangents + (first + i) * 3;
+				const float* b = pBitangents + (first + i) * 3;
+				float handedness = (n[1] * t[2] - n[2] * t[1]) * b[0]
+					+ (n[2] * t[0] - n[0] * t[2]) * b[1]
+					+ (n[0] * t[1] - n[1] * t[0]) * b[2];
+				pDst[i * 4 + 2] = handedness < 0.0f ? T(-maxValue) : maxValue;
+				pDst[i * 4 + 3] = 0;
+			}
+		});
+
+	auto pAccTangents = asset.createAccessor<T>(GLTFAccessorType::VEC4);
+	pAccTangents->setNormalized(true);
+	pAccTangents->setElementCount(numVertices);
+	_setAccessorView(pAccTangents, pBuffer->addView(pTangentSource, ViewTarget::ArrayBuffer));
+
+	ref.name = "_TANGENT_OCT";
+	ref.accessorIndex = pAccTangents->index();
+	ref.extras = json::object();
+	_customAttributeRefs.push_back(ref);
+}
+
+Result GLTFExporter::_loadCustomAttributes(const aiMesh* pAiMesh)
+{
+	_customAttributes.clear();
+	size_t numVertices = pAiMesh->mNumVertices;
+
+	for (const auto& attribOptions : _options.customAttributes) {
+		customAttributeData_t attrib;
+		attrib.name = attribOptions.name;
+		attrib.numComponents = attribOptions.numComponents;
+		attrib.dracoId = -1;
+
+		// application-specific attribute names must start with an underscore
+		if (attrib.name.empty() || attrib.name[0] != '_') {
+			attrib.name = "_" + attrib.name;
+		}
+		if (attrib.numComponents < 1 || attrib.numComponents > 4) {
+			return Result::error("custom attribute " + attrib.name + " must have 1 to 4 components");
+		}
+
+		attrib.data.resize(numVertices * attrib.numComponents);
+		float* pDst = attrib.data.data();
+		size_t numComponents = attrib.numComponents;
+		uint32_t channel = attribOptions.channel;
+
+		if (attribOptions.source == CustomAttributeSource::TexCoords) {
+			if (channel >= AI_MAX_NUMBER_OF_TEXTURECOORDS || !pAiMesh->HasTextureCoords(channel) || numComponents > 3) {
+				return Result::error("custom attribute " + attrib.name + ": invalid UV channel or component count");
+			}
+			const float* pSrc = (const float*)pAiMesh->mTextureCoords[channel];
+			for (size_t i = 0; i < numVertices; ++i) {
+				for (size_t c = 0; c < numComponents; ++c) {
+					pDst[i * numComponents + c] = pSrc[i * 3 + c];
+				}
+			}
+		}
+		else if (attribOptions.source == CustomAttributeSource::Colors) {
+			if (channel >= AI_MAX_NUMBER_OF_COLOR_SETS || !pAiMesh->HasVertexColors(channel)) {
+				return Result::error("custom attribute " + attrib.name + ": invalid color channel");
+			}
+			const float* pSrc = (const float*)pAiMesh->mColors[channel];
+			for (size_t i = 0; i < numVertices; ++i) {
+				for (size_t c = 0; c < numComponents; ++c) {
+					pDst[i * numComponents + c] = pSrc[i * 4 + c];
+				}
+			}
+		}
+		else {
+			std::ifstream stream(attribOptions.file, std::ios::in | std::ios::binary | std::ios::ate);
+			if (!stream.is_open()) {
+				return Result::error("custom attribute " + attrib.name + ": failed to read " + attribOptions.file);
+			}
+
+			// the values follow the vertex order of the input file, which is kept only if the
+			// vertex count is unchanged (vertices aren't joined while sidecar files are used)
+			size_t elementSize = numComponents * sizeof(float);
+			size_t fileSize = size_t(stream.tellg());
+			if (fileSize != numVertices * elementSize) {
+				return Result::error("custom attribute " + attrib.name + ": " + attribOptions.file + " holds "
+					+ std::to_string(fileSize / elementSize) + " values, the mesh has " + std::to_string(numVertices) + " vertices");
+			}
+			stream.seekg(0);
+			if (!stream.read((char*)pDst, fileSize)) {
+				return Result::error("custom attribute " + attrib.name + ": failed to read " + attribOptions.file);
+			}
+		}
+
+		if (_options.verbose) {
+			cout << "Custom attribute: " << attrib.name << ", components: " << numComponents << endl;
+		}
+
+		_customAttributes.push_back(std::move(attrib));
+	}
+
+	return Result::ok();
+}
+
+void GLTFExporter::_exportCustomAttributes(const aiMesh* pAiMesh, GLTFAsset& asset,
+	GLTFMesh* pMesh, size_t primitiveIndex, BinaryBuffer* pBuffer, const std::vector<uint32_t>* pVertexMap)
+{
+	static const GLTFAccessorType accessorTypes[] = {
+		GLTFAccessorType::SCALAR, GLTFAccessorType::VEC2, GLTFAccessorType::VEC3, GLTFAccessorType::VEC4
+	};
+
+	size_t numVertices = pAiMesh->mNumVertices;
+
+	for (auto& attrib : _customAttributes) {
+		auto pAccessor = asset.createAccessor<float>(accessorTypes[attrib.numComponents - 1]);
+		pAccessor->setElementCount(numVertices);
+
+		// without buffer, the data is part of the Draco compressed mesh,
+		// otherwise the buffer takes over the loaded data or the chunk's part of it
+		if (pBuffer && pVertexMap) {
+			size_t numComponents = attrib.numComponents;
+			std::vector<float> data(numVertices * numComponents);
+			for (size_t i = 0; i < numVertices; ++i) {
+				const float* pSrc = attrib.data.data() + size_t((*pVertexMap)[i]) * numComponents;
+				std::copy(pSrc, pSrc + numComponents, data.data() + i * numComponents);
+			}
+			_setAccessorView(pAccessor, pBuffer->addView(MemorySource::fromVector(std::move(data)), ViewTarget::ArrayBuffer));
+		}
+		else if (pBuffer) {
+			_setAccessorView(pAccessor, pBuffer->addView(MemorySource::fromVector(std::move(attrib.data)), ViewTarget::ArrayBuffer));
+		}
+
+		customAttributeRef_t ref;
+		ref.meshIndex = pMesh->index();
+		ref.primitiveIndex = primitiveIndex;
+		ref.name = attrib.name;
+		ref.accessorIndex = pAccessor->index();
+		ref.dracoId = attrib.dracoId;
+		_customAttributeRefs.push_back(ref);
+	}
+}
 
 GLTFExporter::materialResult_t GLTFExporter::_exportMaterial(
-	const aiScene* pAiScene, size_t meshIndex, flow::GLTFAsset& asset, GLTFBuffer* pBuffer)
+	const aiScene* pAiScene, size_t meshIndex, flow::GLTFAsset& asset, BinaryBuffer* pBuffer)
 {
 	const aiMesh* pAiMesh = pAiScene->mMeshes[meshIndex];
 	const aiMaterial* pAiMaterial = pAiScene->mMaterials[pAiMesh->mMaterialIndex];
@@ -295,12 +1408,15 @@ GLTFExporter::materialResult_t GLTFExporter::_exportMaterial(
 	return Result::error("not implemented yet");
 }
 
-GLTFExporter::materialResult_t GLTFExporter::_createDefaultMaterial(GLTFAsset& asset, GLTFBuffer* pBuffer)
+GLTFExporter::materialResult_t GLTFExporter::_createDefaultMaterial(GLTFAsset& asset, BinaryBuffer* pBuffer)
 {
 	GLTFMaterial* pMaterial = asset.createMaterial("default");
-	GLTFTexture* pTexture = nullptr;
 	json extras = json::object();
 
+	if (_options.bufferGrouping != BufferGrouping::None) {
+		pBuffer->setGroup("textures");
+	}
+
 	GLTFPBRMetallicRoughness pbr;
 	pbr.setMetallicFactor(_options.metallicFactor);
 	pbr.setRoughnessFactor(_options.roughnessFactor);
@@ -313,83 +1429,54 @@ GLTFExporter::materialResult_t GLTFExporter::_createDefaultMaterial(GLTFAsset& a
 		if (_options.verbose) {
 			cout << "diffuse map file: " << _options.diffuseMapFile << endl;
 		}
-		if (_options.embedMaps) {
-			auto pTexDiffuseView = pBuffer->addImage(_options.diffuseMapFile);
-			if (!pTexDiffuseView) {
-				return Result::error(string("failed to read diffuse map: " + _options.diffuseMapFile));
-			}
-			pTexture = asset.createTexture(pTexDiffuseView, _mimeTypeFromExtension(_options.diffuseMapFile));
-		}
-		else {
-			pTexture = asset.createTexture(path(_options.diffuseMapFile).filename());
+		auto textureResult = _createMapTexture(asset, pBuffer, _options.diffuseMapFile, "diffuse", TextureUsage::Color);
+		if (textureResult.isError()) {
+			return textureResult;
 		}
-		pbr.setBaseColorTexture(pTexture);
+		pbr.setBaseColorTexture(textureResult.value());
 	}
 	if (!_options.occlusionMapFile.empty()) {
 		if (_options.verbose) {
 			cout << "occlusion map file: " << _options.occlusionMapFile << endl;
 		}
-		if (_options.embedMaps) {
-			auto pTexOcclusionView = pBuffer->addImage(_options.occlusionMapFile);
-			if (!pTexOcclusionView) {
-				return Result::error(string("failed to read occlusion map: " + _options.occlusionMapFile));
-			}
-			pTexture = asset.createTexture(pTexOcclusionView, _mimeTypeFromExtension(_options.occlusionMapFile));
-		}
-		else {
-			pTexture = asset.createTexture(path(_options.occlusionMapFile).filename());
+		auto textureResult = _createMapTexture(asset, pBuffer, _options.occlusionMapFile, "occlusion", TextureUsage::Linear);
+		if (textureResult.isError()) {
+			return textureResult;
 		}
-		pMaterial->setOcclusionTexture(pTexture);
+		pMaterial->setOcclusionTexture(textureResult.value());
 	}
 	if (!_options.emissiveMapFile.empty()) {
 		if (_options.verbose) {
 			cout << "emissive map file: " << _options.emissiveMapFile << endl;
 		}
-		if (_options.embedMaps) {
-			auto pTexEmissiveView = pBuffer->addImage(_options.emissiveMapFile);
-			if (!pTexEmissiveView) {
-				return Result::error(string("failed to read emissive map: " + _options.emissiveMapFile));
-			}
-			pTexture = asset.createTexture(pTexEmissiveView, _mimeTypeFromExtension(_options.emissiveMapFile));
-		}
-		else {
-			pTexture = asset.createTexture(path(_options.emissiveMapFile).filename());
+		auto textureResult = _createMapTexture(asset, pBuffer, _options.emissiveMapFile, "emissive", TextureUsage::Color);
+		if (textureResult.isError()) {
+			return textureResult;
 		}
-		pMaterial->setEmissiveTexture(pTexture);
+		pMaterial->setEmissiveTexture(textureResult.value());
 	}
 	if (!_options.metallicRoughnessMapFile.empty()) {
 		if (_options.verbose) {
 			cout << "metallic-roughness map file: " << _options.metallicRoughnessMapFile << endl;
 		}
-		if (_options.embedMaps) {
-			auto pTexMetRoughView = pBuffer->addImage(_options.metallicRoughnessMapFile);
-			if (!pTexMetRoughView) {
-				return Result::error(string("failed to read metallic-roughness map: " + _options.metallicRoughnessMapFile));
-			}
-			pTexture = asset.createTexture(pTexMetRoughView, _mimeTypeFromExtension(_options.metallicRoughnessMapFile));
+		// a packed ORM map has the same content as the occlusion map and shares its texture
+		auto textureResult = _createMapTexture(asset, pBuffer, _options.metallicRoughnessMapFile, "metallic-roughness", TextureUsage::Linear);
+		if (textureResult.isError()) {
+			return textureResult;
 		}
-		else {
-			pTexture = asset.createTexture(path(_options.metallicRoughnessMapFile).filename());
-		}
-		pbr.setMetallicRoughnessTexture(pTexture);
+		pbr.setMetallicRoughnessTexture(textureResult.value());
 	}
 	if (!_options.zoneMapFile.empty()) {
 		if (_options.verbose) {
 			cout << "zone map file: " << _options.zoneMapFile << endl;
 		}
-		if (_options.embedMaps) {
-			auto pTexZoneView = pBuffer->addImage(_options.zoneMapFile);
-			if (!pTexZoneView) {
-				return Result::error(string("failed to read zone map: " + _options.zoneMapFile));
-			}
-			pTexture = asset.createTexture(pTexZoneView, _mimeTypeFromExtension(_options.zoneMapFile));
-		}
-		else {
-			pTexture = asset.createTexture(path(_options.zoneMapFile).filename());
+		auto textureResult = _createMapTexture(asset, pBuffer, _options.zoneMapFile, "zone", TextureUsage::Data);
+		if (textureResult.isError()) {
+			return textureResult;
 		}
 
 		GLTFTextureInfo zoneTexture;
-		zoneTexture.set(pTexture);
+		zoneTexture.set(textureResult.value());
 
 		extras["zoneTexture"] = zoneTexture.toJSON();
 	}
@@ -397,17 +1484,11 @@ GLTFExporter::materialResult_t GLTFExporter::_createDefaultMaterial(GLTFAsset& a
 		if (_options.verbose) {
 			cout << "Normal map file: " << _options.normalMapFile << endl;
 		}
-		if (_options.embedMaps) {
-			auto pTexNormalView = pBuffer->addImage(_options.normalMapFile);
-			if (!pTexNormalView) {
-				return Result::error(string("failed to read normal map: " + _options.normalMapFile));
-			}
-			pTexture = asset.createTexture(pTexNormalView, _mimeTypeFromExtension(_options.normalMapFile));
-		}
-		else {
-			pTexture = asset.createTexture(path(_options.normalMapFile).filename());
+		auto textureResult = _createMapTexture(asset, pBuffer, _options.normalMapFile, "normal", TextureUsage::Normal);
+		if (textureResult.isError()) {
+			return textureResult;
 		}
-		pMaterial->setNormalTexture(pTexture);
+		pMaterial->setNormalTexture(textureResult.value());
 
 		if (_options.objectSpaceNormals) {
 			extras["objectSpaceNormals"] = true;
@@ -423,16 +1504,560 @@ GLTFExporter::materialResult_t GLTFExporter::_createDefaultMaterial(GLTFAsset& a
 	return ResultT<GLTFMaterial*>(pMaterial);
 }
 
-Result GLTFExporter::_dracoCompressMesh(
-	const aiMesh* pMesh, GLTFDracoExtension* pDracoExtension, GLTFBuffer* pBuffer)
+ResultT<GLTFTexture*> GLTFExporter::_createMapTexture(GLTFAsset& asset,
+	BinaryBuffer* pBuffer, const string& mapFile, const string& mapName, TextureUsage usage)
+{
+	string key = _textureKey(mapFile, usage);
+	auto textureIt = _mapTextures.find(key);
+	if (textureIt != _mapTextures.end()) {
+		if (_options.verbose) {
+			cout << "Sharing texture of identical map: " << mapFile << endl;
+		}
+		return ResultT<GLTFTexture*>(textureIt->second);
+	}
+
+	const string& filePath = _mapFile(mapFile);
+
+	auto it = _processedTextures.find(key);
+	const processedTexture_t* pProcessed = it != _processedTextures.end() ? &it->second : nullptr;
+	const encodedImage_t* pSourceImage = _textureSource(pProcessed);
+
+	GLTFTexture* pTexture = nullptr;
+
+	if (pSourceImage) {
+		pTexture = _createEncodedTexture(asset, pBuffer, *pSourceImage);
+	}
+	else if (_options.embedMaps) {
+		// preloaded by _prepareMaps() unless the map was added after it ran
+		auto sourceIt = _mapSources.find(filePath);
+		auto pSource = sourceIt != _mapSources.end() ? sourceIt->second.get() : FileSource::create(filePath);
+		if (!pSource) {
+			return Result::error("failed to read " + mapName + " map: " + filePath);
+		}
+		pTexture = _createEmbeddedTexture(asset, pBuffer->addView(pSource), filePath);
+	}
+	else {
+		pTexture = asset.createTexture(path(filePath).filename());
+	}
+
+	_mapTextures[key] = pTexture;
+
+	if (!pProcessed || (pProcessed->extension.empty() && pProcessed->mipmaps.empty())) {
+		return ResultT<GLTFTexture*>(pTexture);
+	}
+
+	textureImageRef_t ref;
+	ref.textureIndex = pTexture->index();
+	ref.extension = pProcessed->extension;
+
+	// the original image stays the texture's source, the encoded one is added for the extension
+	bool hasFallback = !pProcessed->extension.empty() && _options.webpMaps && _options.webpFallback;
+	if (hasFallback) {
+		ref.image = _encodedImageToJSON(pBuffer, pProcessed->image);
+	}
+
+	for (const auto& level : pProcessed->mipmaps) {
+		json jsonLevel = _encodedImageToJSON(pBuffer, level);
+		jsonLevel["width"] = level.width;
+		jsonLevel["height"] = level.height;
+		ref.mipmaps.push_back(jsonLevel);
+	}
+
+	_textureImageRefs.push_back(ref);
+
+	return ResultT<GLTFTexture*>(pTexture);
+}
+
+GLTFTexture* GLTFExporter::_createEncodedTexture(GLTFAsset& asset, BinaryBuffer* pBuffer, const encodedImage_t& image)
+{
+	if (!_options.embedMaps) {
+		return asset.createTexture(path(image.filePath).filename());
+	}
+
+	auto pView = pBuffer->addView(std::make_shared<MemorySource>(image.pData->data(), image.pData->size(), image.pData));
+	return _createEmbeddedTexture(asset, pView, image.filePath);
+}
+
+json GLTFExporter::_encodedImageToJSON(BinaryBuffer* pBuffer, const encodedImage_t& image)
+{
+	if (!_options.embedMaps) {
+		return json{ { "uri", path(image.filePath).filename() } };
+	}
+
+	auto pView = pBuffer->addView(std::make_shared<MemorySource>(image.pData->data(), image.pData->size(), image.pData));
+	pView->setPriority(_priorityDetail);
+
+	return json{ { "bufferView", pView->index() }, { "mimeType", _mimeTypeFromExtension(image.filePath) } };
+}
+
+Result GLTFExporter::_prepareMaps(const string& outputDir)
+{
+	Result result = _deduplicateMaps();
+	if (result.isError()) {
+		return result;
+	}
+
+	if (_options.textureCompression != TextureCompression::None || _options.webpMaps
+			|| !_options.maxMapSizes.empty() || _options.mapMipmaps) {
+		result = _processTextures(outputDir);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	if (!_options.embedMaps) {
+		return Result::ok();
+	}
+
+	// map files embedded as they are are mapped and read in parallel, the mappings are
+	// handed to the buffer and written without copies
+	const std::pair<const string*, TextureUsage> maps[] = {
+		{ &_options.diffuseMapFile, TextureUsage::Color },
+		{ &_options.occlusionMapFile, TextureUsage::Linear },
+		{ &_options.emissiveMapFile, TextureUsage::Color },
+		{ &_options.metallicRoughnessMapFile, TextureUsage::Linear },
+		{ &_options.zoneMapFile, TextureUsage::Data },
+		{ &_options.normalMapFile, TextureUsage::Normal }
+	};
+
+	for (const auto& map : maps) {
+		if (map.first->empty()) {
+			continue;
+		}
+
+		auto it = _processedTextures.find(_textureKey(*map.first, map.second));
+		string filePath = _mapFile(*map.first);
+
+		if (!_textureSource(it != _processedTextures.end() ? &it->second : nullptr) && !_mapSources.count(filePath)) {
+			_mapSources[filePath] = std::async(std::launch::async, [filePath]() {
+				return FileSource::create(filePath, true);
+			}).share();
+		}
+	}
+
+	return Result::ok();
+}
+
+Result GLTFExporter::_deduplicateMaps()
+{
+	std::vector<string> mapFiles;
+	for (const string* pMapFile : { &_options.diffuseMapFile, &_options.occlusionMapFile, &_options.emissiveMapFile,
+			&_options.metallicRoughnessMapFile, &_options.zoneMapFile, &_options.normalMapFile }) {
+		if (!pMapFile->empty() && std::find(mapFiles.begin(), mapFiles.end(), *pMapFile) == mapFiles.end()) {
+			mapFiles.push_back(*pMapFile);
+		}
+	}
+
+	// only files of the same size can be identical, the others aren't read for hashing
+	std::vector<uint64_t> sizes;
+	std::map<uint64_t, size_t> sizeCounts;
+	for (const auto& mapFile : mapFiles) {
+		path filePath(mapFile);
+		if (!filePath.exists()) {
+			return Result::error("file not found: " + mapFile);
+		}
+		sizes.push_back(filePath.file_size());
+		sizeCounts[sizes.back()]++;
+	}
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < mapFiles.size(); ++i) {
+		if (sizeCounts[sizes[i]] > 1) {
+			candidates.push_back(i);
+		}
+	}
+
+	if (candidates.empty()) {
+		return Result::ok();
+	}
+
+	ContentHashCache cache;
+	if (!_options.hashCacheFile.empty()) {
+		Result cacheResult = cache.load(_options.hashCacheFile);
+		if (cacheResult.isError()) {
+			return cacheResult;
+		}
+	}
+
+	std::vector<std::future<ResultT<uint64_t>>> hashers;
+	for (size_t index : candidates) {
+		string mapFile = mapFiles[index];
+		hashers.push_back(std::async(std::launch::async, [&cache, mapFile]() {
+			return cache.fileHash(mapFile);
+		}));
+	}
+
+	// files of the same size and hash are identical, all of them are aliases of the first one
+	std::map<std::pair<uint64_t, uint64_t>, string> filesByContent;
+	Result result = Result::ok();
+
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		auto hashResult = hashers[i].get();
+		if (hashResult.isError()) {
+			if (!result.isError()) {
+				result = hashResult;
+			}
+			continue;
+		}
+
+		const string& mapFile = mapFiles[candidates[i]];
+		auto it = filesByContent.emplace(std::make_pair(hashResult.value(), sizes[candidates[i]]), mapFile).first;
+		if (it->second != mapFile) {
+			_mapFileAliases[mapFile] = it->second;
+			if (_options.verbose) {
+				cout << "Map " << mapFile << " is identical to " << it->second << endl;
+			}
+		}
+	}
+
+	if (result.isError()) {
+		return result;
+	}
+
+	if (!_options.hashCacheFile.empty()) {
+		return cache.save(_options.hashCacheFile);
+	}
+
+	return Result::ok();
+}
+
+const GLTFExporter::encodedImage_t* GLTFExporter::_textureSource(const processedTexture_t* pProcessed) const
+{
+	if (!pProcessed) {
+		return nullptr;
+	}
+
+	// with a fallback, the texture's source is the map in its original format
+	bool hasFallback = !pProcessed->extension.empty() && _options.webpMaps && _options.webpFallback;
+
+	if (!hasFallback && pProcessed->image.pData) {
+		return &pProcessed->image;
+	}
+	if (pProcessed->fallback.pData) {
+		return &pProcessed->fallback;
+	}
+
+	return nullptr;
+}
+
+const string& GLTFExporter::_mapFile(const string& filePath) const
+{
+	auto it = _mapFileAliases.find(filePath);
+	return it != _mapFileAliases.end() ? it->second : filePath;
+}
+
+string GLTFExporter::_textureKey(const string& filePath, TextureUsage usage) const
+{
+	// maps with identical content share a texture if they are encoded the same way: KTX2
+	// stores the color space and encodes normals as UASTC, WebP normals are lossless and
+	// zone maps keep their exact IDs
+	bool isKtx = !_options.webpMaps && _options.textureCompression != TextureCompression::None;
+	bool isProcessed = isKtx || _options.webpMaps || !_options.maxMapSizes.empty() || _options.mapMipmaps;
+
+	const string& key = _mapFile(filePath);
+
+	if (usage == TextureUsage::Data && isProcessed) {
+		return key + "#data";
+	}
+	if (usage == TextureUsage::Normal && (isKtx || _options.webpMaps)) {
+		return key + "#normal";
+	}
+	if (usage == TextureUsage::Color && isKtx) {
+		return key + "#color";
+	}
+
+	return key;
+}
+
+Result GLTFExporter::_processTextures(const string& outputDir)
+{
+	if (_options.webpMaps && !Image::isWebPSupported()) {
+		return Result::error("WebP encoding not available in this build");
+	}
+	if (!_options.webpMaps && _options.textureCompression != TextureCompression::None && !KtxEncoder::isAvailable()) {
+		return Result::error("KTX2 texture compression not available in this build");
+	}
+
+	struct textureJob_t
+	{
+		string filePath;
+		TextureUsage usage;
+		const char* pSizeKey;
+		processedTexture_t* pTexture;
+		size_t maxSize;
+		bool mipmaps;
+	};
+
+	const textureJob_t candidates[] = {
+		{ _options.diffuseMapFile, TextureUsage::Color, "diffuse" },
+		{ _options.occlusionMapFile, TextureUsage::Linear, "occlusion" },
+		{ _options.emissiveMapFile, TextureUsage::Color, "emissive" },
+		{ _options.metallicRoughnessMapFile, TextureUsage::Linear, "metallicRoughness" },
+		{ _options.normalMapFile, TextureUsage::Normal, "normal" },
+		{ _options.zoneMapFile, TextureUsage::Data, "zone" }
+	};
+
+	std::vector<textureJob_t> jobs;
+	for (auto job : candidates) {
+		if (job.filePath.empty()) {
+			continue;
+		}
+
+		// maps with identical content are processed once
+		string key = _textureKey(job.filePath, job.usage);
+		job.filePath = _mapFile(job.filePath);
+		if (_processedTextures.count(key)) {
+			continue;
+		}
+
+		auto it = _options.maxMapSizes.find(job.pSizeKey);
+		job.maxSize = it != _options.maxMapSizes.end() ? it->second : 0;
+
+		// the zone map holds IDs, lossy compression would mix them, it is only stored as lossless WebP
+		string extension;
+		if (_options.webpMaps) {
+			extension = "EXT_texture_webp";
+		}
+		else if (_options.textureCompression != TextureCompression::None && job.usage != TextureUsage::Data) {
+			extension = "KHR_texture_basisu";
+		}
+
+		job.mipmaps = _options.mapMipmaps && extension != "KHR_texture_basisu" && job.usage != TextureUsage::Data;
+
+		// maps within their maximum size are left untouched unless they are re-encoded
+		if (extension.empty() && !job.mipmaps) {
+			if (job.maxSize == 0) {
+				continue;
+			}
+			size_t width, height, channels;
+			Result infoResult = Image::readInfo(job.filePath, width, height, channels);
+			if (!infoResult.isError() && std::max(width, height) <= job.maxSize) {
+				continue;
+			}
+		}
+
+		job.pTexture = &_processedTextures[key];
+		job.pTexture->extension = extension;
+		job.pTexture->sourceFile = job.filePath;
+		job.pTexture->mapName = job.pSizeKey;
+		jobs.push_back(job);
+	}
+
+	if (jobs.empty()) {
+		return Result::ok();
+	}
+
+	if (_options.verbose) {
+		cout << "Processing " << jobs.size() << " maps" << endl;
+	}
+
+	// maps are processed in parallel, each one with its share of the threads
+	size_t numThreads = std::max(parallelThreadCount() / jobs.size(), size_t(1));
+	TextureCompression compression = _options.textureCompression;
+	float webpQuality = _options.webpQuality;
+	bool webpFallback = _options.webpFallback;
+	uint64_t maxPixels = _options.maxMapPixels;
+	std::vector<std::future<Result>> processors;
+
+	for (const auto& job : jobs) {
+		processors.push_back(std::async(std::launch::async, [job, compression, webpQuality, webpFallback, maxPixels, numThreads]() {
+			processedTexture_t& texture = *job.pTexture;
+			bool isWebP = texture.extension == "EXT_texture_webp";
+
+			// WebP images are limited in size, larger maps are scaled down to fit
+			size_t maxSize = job.maxSize;
+			if (isWebP) {
+				maxSize = maxSize > 0 ? std::min(maxSize, _maxWebPSize) : _maxWebPSize;
+			}
+
+			size_t width, height, channels;
+			Result result = Image::readInfo(job.filePath, width, height, channels);
+			if (result.isError()) {
+				return result;
+			}
+
+			// maps above the pixel budget are scaled down to fit, the decoded map and the
+			// encoder's copy of it are bounded by the budget regardless of the map size
+			if (maxPixels > 0 && uint64_t(width) * height > maxPixels) {
+				double scale = std::sqrt(double(maxPixels) / (double(width) * double(height)));
+				size_t budgetSize = std::max(size_t(std::max(width, height) * scale), size_t(1));
+				maxSize = maxSize > 0 ? std::min(maxSize, budgetSize) : budgetSize;
+			}
+
+			bool isResized = maxSize > 0 && std::max(width, height) > maxSize;
+
+			// IDs of the zone map must not be blended
+			ImageFilter filter = job.usage == TextureUsage::Data ? ImageFilter::Nearest : ImageFilter::Smooth;
+
+			// maps are scaled down while decoding, the full-size map is never held in memory
+			Image image;
+			result = image.loadScaled(job.filePath, isResized ? maxSize : 0, filter, numThreads);
+			if (result.isError()) {
+				return result;
+			}
+
+			bool lossless = job.usage == TextureUsage::Normal || job.usage == TextureUsage::Data;
+
+			auto encode = [&](const Image& level, encodedImage_t& encoded, bool originalFormat) {
+				encoded.pData = std::make_shared<std::vector<uint8_t>>();
+				encoded.width = level.width();
+				encoded.height = level.height();
+
+				if (originalFormat) {
+					return level.encode(job.filePath, *encoded.pData);
+				}
+				if (isWebP) {
+					return level.encodeWebP(webpQuality, lossless, *encoded.pData);
+				}
+				return KtxEncoder::encode(level, compression, job.usage, numThreads, *encoded.pData);
+			};
+
+			// a map that keeps its size and format is used as is, only its mipmaps are written
+			if (isResized || !texture.extension.empty()) {
+				result = encode(image, texture.image, texture.extension.empty());
+			}
+			if (!result.isError() && isResized && isWebP && webpFallback) {
+				result = encode(image, texture.fallback, true);
+			}
+
+			// each level is filtered from the previous one, only two levels are in memory at a time
+			if (job.mipmaps) {
+				Image level;
+				const Image* pPrevious = &image;
+				while (!result.isError() && std::max(pPrevious->width(), pPrevious->height()) > _minMipmapSize) {
+					level = pPrevious->resized(std::max(pPrevious->width() / 2, size_t(1)), std::max(pPrevious->height() / 2, size_t(1)), filter);
+					pPrevious = &level;
+					texture.mipmaps.emplace_back();
+					result = encode(level, texture.mipmaps.back(), !isWebP);
+				}
+			}
+
+			if (result.isError()) {
+				return Result::error(result.message() + ": " + job.filePath);
+			}
+
+			return Result::ok();
+		}));
+	}
+
+	Result result = Result::ok();
+	for (auto& processor : processors) {
+		Result processorResult = processor.get();
+		if (processorResult.isError() && !result.isError()) {
+			result = processorResult;
+		}
+	}
+
+	if (result.isError()) {
+		return result;
+	}
+
+	std::vector<encodedImage_t*> images;
+
+	std::set<string> baseNames;
+
+	for (auto& entry : _processedTextures) {
+		processedTexture_t& texture = entry.second;
+
+		string fileName = path(texture.sourceFile).filename();
+		size_t dotPos = fileName.find_last_of('.');
+		string baseName = path(path(outputDir) / fileName.substr(0, dotPos)).str();
+		string originalExtension = fileName.substr(dotPos);
+
+		// a map encoded differently for several uses is named after each use
+		if (!baseNames.insert(baseName).second) {
+			baseName += "-" + texture.mapName;
+		}
+
+		// resized maps are named after their size, so they never replace the source map
+		auto sizeSuffix = [](const encodedImage_t& image) {
+			return "-" + std::to_string(image.width) + "x" + std::to_string(image.height);
+		};
+
+		string extension = originalExtension;
+		if (texture.extension == "EXT_texture_webp") {
+			extension = ".webp";
+			texture.image.filePath = baseName + extension;
+		}
+		else if (texture.extension == "KHR_texture_basisu") {
+			texture.image.filePath = baseName + ".ktx2";
+		}
+		else if (texture.image.pData) {
+			texture.image.filePath = baseName + sizeSuffix(texture.image) + extension;
+		}
+		if (texture.image.pData) {
+			images.push_back(&texture.image);
+		}
+
+		if (texture.fallback.pData) {
+			texture.fallback.filePath = baseName + sizeSuffix(texture.fallback) + originalExtension;
+			images.push_back(&texture.fallback);
+		}
+
+		for (size_t i = 0; i < texture.mipmaps.size(); ++i) {
+			texture.mipmaps[i].filePath = baseName + "-mip" + std::to_string(i + 1) + extension;
+			images.push_back(&texture.mipmaps[i]);
+		}
+	}
+
+	if (_options.embedMaps) {
+		return Result::ok();
+	}
+
+	for (const auto pImage : images) {
+		if (_options.verbose) {
+			cout << "Writing texture: " << pImage->filePath << endl;
+		}
+
+		// encoded images are compressed already, no precompressed copies
+		OutputFile file;
+		if (!file.open(pImage->filePath)
+				|| !file.write(pImage->pData->data(), pImage->pData->size())
+				|| !file.close()) {
+			return Result::error("failed to write texture: " + pImage->filePath);
+		}
+	}
+
+	return Result::ok();
+}
+
+GLTFTexture* GLTFExporter::_createEmbeddedTexture(GLTFAsset& asset, BinaryView* pView, const string& filePath)
 {
-	draco::Mesh dracoMesh;
+	pView->setPriority(pView->byteLength() <= _maxSmallTextureSize ? _priorityFirstRender : _priorityDetail);
+
+	// the image is referenced by its file name until the buffer view is patched in
+	GLTFTexture* pTexture = asset.createTexture(path(filePath).filename());
+
+	textureViewRef_t ref;
+	ref.textureIndex = pTexture->index();
+	ref.viewIndex = pView->index();
+	ref.mimeType = _mimeTypeFromExtension(filePath);
+	_textureViewRefs.push_back(ref);
+
+	return pTexture;
+}
+
+ResultT<BinaryView*> GLTFExporter::_dracoCompressMesh(
+	const aiMesh* pMesh, GLTFDracoExtension* pDracoExtension, BinaryBuffer* pBuffer)
+{
+	bool isPointCloud = _isPointCloud(pMesh);
+	std::unique_ptr<draco::PointCloud> pDracoGeometry;
 
 	if (_options.verbose) {
-		cout << "Draco Compression: Build Mesh" << endl;
+		cout << "Draco Compression: Build " << (isPointCloud ? "Point Cloud" : "Mesh") << endl;
+	}
+
+	Result result;
+	if (isPointCloud) {
+		pDracoGeometry.reset(new draco::PointCloud());
+		result = _dracoBuildPointCloud(pMesh, pDracoGeometry.get(), pDracoExtension);
+	}
+	else {
+		draco::Mesh* pDracoMesh = new draco::Mesh();
+		pDracoGeometry.reset(pDracoMesh);
+		result = _dracoBuildMesh(pMesh, pDracoMesh, pDracoExtension);
 	}
 
-	Result result = _dracoBuildMesh(pMesh, &dracoMesh, pDracoExtension);
 	if (result.isError()) {
 		return result;
 	}
@@ -440,28 +2065,50 @@ Result GLTFExporter::_dracoCompressMesh(
 	if (_options.verbose) {
 		cout << "Draco Compression: Encode Mesh" << endl;
 	}
-	draco::EncoderBuffer encoderBuffer;
-	draco::Encoder encoder;
-	
-	int encodingSpeed = flow::max(0, 10 - _options.draco.compressionLevel);
-	encoder.SetSpeedOptions(encodingSpeed, encodingSpeed);
-	encoder.SetAttributeQuantization(GeometryAttribute::POSITION, _options.draco.positionQuantizationBits);
-	encoder.SetAttributeQuantization(GeometryAttribute::NORMAL, _options.draco.normalsQuantizationBits);
-	encoder.SetAttributeQuantization(GeometryAttribute::TEX_COORD, _options.draco.texCoordsQuantizationBits);
-	encoder.SetAttributeQuantization(GeometryAttribute::GENERIC, _options.draco.genericQuantizationBits);
+	// the encoded data is written from the encoder buffer, which is kept alive by its view
+	auto pEncoderBuffer = std::make_shared<draco::EncoderBuffer>();
+	draco::EncoderBuffer& encoderBuffer = *pEncoderBuffer;
+	dracoQuantization_t quantization;
+	quantization.positionBits = _options.draco.positionQuantizationBits;
+	quantization.normalsBits = _options.draco.normalsQuantizationBits;
+	quantization.texCoordsBits = _options.draco.texCoordsQuantizationBits;
+	quantization.genericBits = _options.draco.genericQuantizationBits;
+
+	if (_options.draco.maxError > 0.0f || _options.draco.maxRelativeError > 0.0f) {
+		ResultT<dracoQuantization_t> quantizationResult = _dracoEncodeAuto(pMesh, *pDracoGeometry, encoderBuffer);
+		if (quantizationResult.isError()) {
+			return quantizationResult;
+		}
+		quantization = quantizationResult.value();
+	}
+	else {
+		draco::Encoder encoder;
+		Result setupResult = _dracoSetupEncoder(encoder, pMesh, quantization);
+		if (setupResult.isError()) {
+			return setupResult;
+		}
+
+		auto encodeStatus = _dracoEncode(encoder, *pDracoGeometry, isPointCloud, &encoderBuffer);
+		if (!encodeStatus.ok()) {
+			return Result::error(string("Draco failed to encode mesh: ") + encodeStatus.error_msg());
+		}
+	}
 
 	if (_options.verbose) {
 		cout << "Compression Level: " << _options.draco.compressionLevel << endl;
-		cout << "Position Quantization Bits: " << _options.draco.positionQuantizationBits << endl;
-		cout << "Normals Quantization Bits: " << _options.draco.normalsQuantizationBits << endl;
-		cout << "TexCoords Quantization Bits: " << _options.draco.texCoordsQuantizationBits << endl;
-		cout << "Generic Quantization Bits: " << _options.draco.genericQuantizationBits << endl;
+		cout << "Position Quantization Bits: " << quantization.positionBits << endl;
+		cout << "Normals Quantization Bits: " << quantization.normalsBits << endl;
+		cout << "TexCoords Quantization Bits: " << quantization.texCoordsBits << endl;
+		cout << "Generic Quantization Bits: " << quantization.genericBits << endl;
 	}
 
-	auto encodeStatus = encoder.EncodeMeshToBuffer(dracoMesh, &encoderBuffer);
-	if (!encodeStatus.ok()) {
-		return Result::error(string("Draco failed to encode mesh: ") + encodeStatus.error_msg());
-	}
+	json& jsonDraco = _report["draco"];
+	jsonDraco["encodingMethod"] = isPointCloud ? "kdTree" : (_dracoUseSequentialEncoding(pMesh) ? "sequential" : "edgebreaker");
+	jsonDraco["positionQuantizationBits"] = quantization.positionBits;
+	jsonDraco["texCoordsQuantizationBits"] = quantization.texCoordsBits;
+	jsonDraco["normalsQuantizationBits"] = quantization.normalsBits;
+	jsonDraco["genericQuantizationBits"] = quantization.genericBits;
+	jsonDraco["compressedSize"] = encoderBuffer.size();
 
 	if (_options.verbose) {
 		cout << "Draco Compression: Decode Mesh" << endl;
@@ -469,43 +2116,314 @@ Result GLTFExporter::_dracoCompressMesh(
 	draco::Decoder decoder;
 	draco::DecoderBuffer decoderBuffer;
 	decoderBuffer.Init(encoderBuffer.data(), encoderBuffer.size());
-	auto decodeResult = decoder.DecodeMeshFromBuffer(&decoderBuffer);
-	if (!decodeResult.ok()) {
+	bool decodeOk = isPointCloud
+		? decoder.DecodePointCloudFromBuffer(&decoderBuffer).ok()
+		: decoder.DecodeMeshFromBuffer(&decoderBuffer).ok();
+
+	if (!decodeOk) {
 		return Result::error("Draco failed to decode mesh");
 	}
 
-	auto& decodedMesh = decodeResult.value();
+	auto pSource = std::make_shared<MemorySource>(encoderBuffer.data(), encoderBuffer.size(), pEncoderBuffer);
+	BinaryView* pView = pBuffer->addView(pSource);
+	pView->setPriority(_priorityFirstRender);
+	return ResultT<BinaryView*>(pView);
+}
 
-	GLTFBufferView* pEncodedView = pBuffer->addData(encoderBuffer.data(), encoderBuffer.size());
-	pDracoExtension->setEncodedBufferView(pEncodedView);
+Result GLTFExporter::_dracoSetupEncoder(draco::Encoder& encoder, const aiMesh* pMesh, const dracoQuantization_t& quantization) const
+{
+	int encodingSpeed = flow::max(0, 10 - _options.draco.compressionLevel);
+	encoder.SetSpeedOptions(encodingSpeed, encodingSpeed);
+	encoder.SetAttributeQuantization(GeometryAttribute::POSITION, quantization.positionBits);
+	encoder.SetAttributeQuantization(GeometryAttribute::NORMAL, quantization.normalsBits);
+	encoder.SetAttributeQuantization(GeometryAttribute::TEX_COORD, quantization.texCoordsBits);
+	encoder.SetAttributeQuantization(GeometryAttribute::GENERIC, quantization.genericBits);
+	encoder.SetAttributeQuantization(GeometryAttribute::COLOR, quantization.genericBits);
+
+	bool sequential = _dracoUseSequentialEncoding(pMesh);
+	if (_isPointCloud(pMesh)) {
+		encoder.SetEncodingMethod(draco::POINT_CLOUD_KD_TREE_ENCODING);
+	}
+	else {
+		encoder.SetEncodingMethod(sequential ? draco::MESH_SEQUENTIAL_ENCODING : draco::MESH_EDGEBREAKER_ENCODING);
+	}
+
+	// mesh prediction schemes need the connectivity of the edgebreaker encoder
+	const std::pair<GeometryAttribute::Type, DracoPredictionScheme> predictions[] = {
+		{ GeometryAttribute::POSITION, _options.draco.positionPrediction },
+		{ GeometryAttribute::NORMAL, _options.draco.normalsPrediction },
+		{ GeometryAttribute::TEX_COORD, _options.draco.texCoordsPrediction }
+	};
+
+	for (const auto& prediction : predictions) {
+		DracoPredictionScheme scheme = prediction.second;
+		if (scheme == DracoPredictionScheme::Auto) {
+			continue;
+		}
+		if (sequential && scheme != DracoPredictionScheme::None && scheme != DracoPredictionScheme::Difference) {
+			scheme = DracoPredictionScheme::Difference;
+		}
+
+		auto status = encoder.SetAttributePredictionScheme(prediction.first, _dracoPredictionScheme(scheme));
+		if (!status.ok()) {
+			return Result::error(string("invalid Draco prediction scheme: ") + status.error_msg());
+		}
+	}
 
 	return Result::ok();
 }
 
+bool GLTFExporter::_dracoUseSequentialEncoding(const aiMesh* pMesh) const
+{
+	switch (_options.draco.encodingMethod) {
+	case DracoEncodingMethod::Edgebreaker:
+		return false;
+	case DracoEncodingMethod::Sequential:
+		return true;
+	default:
+		break;
+	}
+
+	// very large meshes decode much faster with the sequential encoder
+	if (pMesh->mNumFaces > _options.draco.sequentialFaceThreshold) {
+		return true;
+	}
+
+	// a well connected triangle mesh has about twice as many faces as vertices,
+	// edgebreaker gains little on meshes where most vertices aren't shared
+	return pMesh->mNumFaces < pMesh->mNumVertices;
+}
+
+ResultT<GLTFExporter::dracoQuantization_t> GLTFExporter::_dracoEncodeAuto(
+	const aiMesh* pMesh, const draco::PointCloud& dracoGeometry, draco::EncoderBuffer& encoderBuffer)
+{
+	bool isPointCloud = _isPointCloud(pMesh);
+	Range3f boundingBox = Processor::calculateBoundingBox(pMesh);
+	float maxError = _options.draco.maxError;
+	if (maxError <= 0.0f) {
+		maxError = _options.draco.maxRelativeError * boundingBox.size().length();
+	}
+
+	// every quantized attribute type is tuned against its own budget, the configured bits are the upper bounds
+	struct tuning_t
+	{
+		const char* name;
+		GeometryAttribute::Type type;
+		int dracoQuantization_t::* pBits;
+		int maxBits;
+		int minBits;
+		float budget;
+		std::vector<float> errors;
+		std::vector<int> candidates;
+	};
+
+	tuning_t tunings[] = {
+		{ "position", GeometryAttribute::POSITION, &dracoQuantization_t::positionBits,
+			_options.draco.positionQuantizationBits, _minPositionQuantizationBits, maxError, {}, {} },
+		{ "normals", GeometryAttribute::NORMAL, &dracoQuantization_t::normalsBits,
+			_options.draco.normalsQuantizationBits, _minAttributeQuantizationBits, _options.draco.maxNormalError, {}, {} },
+		{ "texCoords", GeometryAttribute::TEX_COORD, &dracoQuantization_t::texCoordsBits,
+			_options.draco.texCoordsQuantizationBits, _minAttributeQuantizationBits, _options.draco.maxTexCoordError, {}, {} },
+		{ "generic", GeometryAttribute::GENERIC, &dracoQuantization_t::genericBits,
+			_options.draco.genericQuantizationBits, _minAttributeQuantizationBits, _options.draco.maxGenericError, {}, {} }
+	};
+
+	dracoQuantization_t quantization;
+	quantization.positionBits = _options.draco.positionQuantizationBits;
+	quantization.normalsBits = _options.draco.normalsQuantizationBits;
+	quantization.texCoordsBits = _options.draco.texCoordsQuantizationBits;
+	quantization.genericBits = _options.draco.genericQuantizationBits;
+	bool budgetMet = true;
+
+	for (auto& tuning : tunings) {
+		// unquantized attributes and attributes without budget keep the configured bits
+		if (tuning.maxBits <= 0 || tuning.budget <= 0.0f) {
+			continue;
+		}
+
+		tuning.minBits = flow::min(tuning.maxBits, tuning.minBits);
+		tuning.errors.assign(size_t(tuning.maxBits - tuning.minBits + 1), 0.0f);
+		bool hasAttribute = false;
+
+		for (int i = 0; i < dracoGeometry.num_attributes(); ++i) {
+			const draco::PointAttribute& attribute = *dracoGeometry.attribute(i);
+			// colors are quantized with the generic bits
+			GeometryAttribute::Type type = attribute.attribute_type() == GeometryAttribute::COLOR
+				? GeometryAttribute::GENERIC : attribute.attribute_type();
+			if (type != tuning.type || attribute.data_type() != draco::DT_FLOAT32) {
+				continue;
+			}
+
+			std::vector<float> errors = type == GeometryAttribute::NORMAL
+				? _dracoNormalQuantizationErrors(attribute, tuning.minBits, tuning.maxBits)
+				: _dracoQuantizationErrors(attribute, tuning.minBits, tuning.maxBits, type == GeometryAttribute::GENERIC);
+			for (size_t k = 0; k < errors.size(); ++k) {
+				tuning.errors[k] = flow::max(tuning.errors[k], errors[k]);
+			}
+			hasAttribute = true;
+		}
+
+		if (!hasAttribute) {
+			tuning.errors.clear();
+			continue;
+		}
+
+		// grids of different depths aren't nested, so the error isn't monotone in the number of bits
+		// and every depth is checked; if none is within budget, the one with the smallest error is used
+		size_t smallest = 0;
+		for (size_t k = 0; k < tuning.errors.size(); ++k) {
+			if (tuning.errors[k] <= tuning.budget) {
+				tuning.candidates.push_back(tuning.minBits + int(k));
+			}
+			if (tuning.errors[k] < tuning.errors[smallest]) {
+				smallest = k;
+			}
+		}
+		if (tuning.candidates.empty()) {
+			tuning.candidates.push_back(tuning.minBits + int(smallest));
+			budgetMet = false;
+		}
+
+		quantization.*tuning.pBits = tuning.candidates.front();
+	}
+
+	// encodes the variants in parallel and keeps the smallest output
+	size_t numTrials = 0;
+	auto encodeTrials = [&](const std::vector<dracoQuantization_t>& variants) -> Result {
+		std::vector<draco::EncoderBuffer> trialBuffers(variants.size());
+		std::vector<Result> trialResults(variants.size());
+
+		parallelFor(0, variants.size(), [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; ++i) {
+				draco::Encoder encoder;
+				trialResults[i] = _dracoSetupEncoder(encoder, pMesh, variants[i]);
+				if (trialResults[i].isError()) {
+					continue;
+				}
+
+				auto encodeStatus = _dracoEncode(encoder, dracoGeometry, isPointCloud, &trialBuffers[i]);
+				if (!encodeStatus.ok()) {
+					trialResults[i] = Result::error(string("Draco failed to encode mesh: ") + encodeStatus.error_msg());
+				}
+			}
+		}, 1);
+
+		for (size_t i = 0; i < variants.size(); ++i) {
+			if (trialResults[i].isError()) {
+				return trialResults[i];
+			}
+			if (numTrials == 0 || trialBuffers[i].size() < encoderBuffer.size()) {
+				encoderBuffer = std::move(trialBuffers[i]);
+				quantization = variants[i];
+			}
+			++numTrials;
+		}
+
+		return Result::ok();
+	};
+
+	// starting from the smallest depths within budget, the candidate depths of one attribute
+	// type after the other are tried, each in combination with the best depths found so far
+	for (const auto& tuning : tunings) {
+		std::vector<dracoQuantization_t> variants;
+		for (int bits : tuning.candidates) {
+			if (numTrials == 0 || bits != quantization.*tuning.pBits) {
+				dracoQuantization_t variant = quantization;
+				variant.*tuning.pBits = bits;
+				variants.push_back(variant);
+			}
+		}
+		if (variants.empty()) {
+			continue;
+		}
+
+		Result trialResult = encodeTrials(variants);
+		if (trialResult.isError()) {
+			return trialResult;
+		}
+	}
+
+	if (numTrials == 0) {
+		Result trialResult = encodeTrials({ quantization });
+		if (trialResult.isError()) {
+			return trialResult;
+		}
+	}
+
+	json& jsonAuto = _report["draco"]["autoQuantization"];
+	for (const auto& tuning : tunings) {
+		if (tuning.errors.empty()) {
+			continue;
+		}
+
+		float error = tuning.errors[size_t(quantization.*tuning.pBits - tuning.minBits)];
+		if (_options.verbose) {
+			cout << "Draco Auto Quantization: " << tuning.name << " error budget " << tuning.budget
+				<< ", " << quantization.*tuning.pBits << " bits, error " << error << endl;
+		}
+
+		jsonAuto[tuning.name] = {
+			{ "errorBudget", tuning.budget },
+			{ "maxError", error }
+		};
+	}
+
+	jsonAuto["budgetMet"] = budgetMet;
+	jsonAuto["trials"] = numTrials;
+
+	return ResultT<dracoQuantization_t>(quantization);
+}
+
 Result GLTFExporter::_dracoBuildMesh(const aiMesh* pMesh, draco::Mesh* pDracoMesh, GLTFDracoExtension* pDracoExtension)
 {
 	if (pMesh->mPrimitiveTypes != uint32_t(aiPrimitiveType_TRIANGLE)) {
 		return Result::error(string("mesh contains non-triangle primitives: ") + pMesh->mName.C_Str());
 	}
 
-	uint32_t numVertices = pMesh->mNumVertices;
-	uint32_t v2fsize = sizeof(float) * 2;
-	uint32_t v3fsize = sizeof(float) * 3;
-
 	uint32_t numFaces = pMesh->mNumFaces;
 	uint32_t numPoints = numFaces * 3;
 
 	pDracoMesh->set_num_points(numPoints);
 	pDracoMesh->SetNumFaces(numFaces);
 
+	_dracoAddAttributes(pMesh, pDracoMesh, pDracoExtension, false);
+
+	Result result = _dracoAddFaces(pMesh, pDracoMesh);
+	if (result.isError()) {
+		return result;
+	}
+
+#ifdef DRACO_ATTRIBUTE_DEDUPLICATION_SUPPORTED
+	pDracoMesh->DeduplicateAttributeValues();
+	pDracoMesh->DeduplicatePointIds();
+#endif
+
+	return Result::ok();
+}
+
+Result GLTFExporter::_dracoBuildPointCloud(const aiMesh* pMesh, draco::PointCloud* pDracoPointCloud, GLTFDracoExtension* pDracoExtension)
+{
+	// each vertex is a point, attribute values map 1:1 to points
+	pDracoPointCloud->set_num_points(pMesh->mNumVertices);
+	_dracoAddAttributes(pMesh, pDracoPointCloud, pDracoExtension, true);
+
+	return Result::ok();
+}
+
+void GLTFExporter::_dracoAddAttributes(
+	const aiMesh* pMesh, draco::PointCloud* pDracoGeometry, GLTFDracoExtension* pDracoExtension, bool identityMapping)
+{
+	uint32_t numVertices = pMesh->mNumVertices;
+	uint32_t v3fsize = sizeof(float) * 3;
+
 	if (_options.verbose) {
 		cout << "Adding " << numVertices << " attribute values" << endl;
 	}
 
 	GeometryAttribute positionAttribute;
 	positionAttribute.Init(GeometryAttribute::POSITION, nullptr, 3, draco::DT_FLOAT32, false, v3fsize, 0);
-	int posIndex = pDracoMesh->AddAttribute(positionAttribute, false, numVertices);
-	auto pPosAttrib = pDracoMesh->attribute(posIndex);
+	int posIndex = pDracoGeometry->AddAttribute(positionAttribute, identityMapping, numVertices);
+	auto pPosAttrib = pDracoGeometry->attribute(posIndex);
 	pPosAttrib->Reset(numVertices);
 	pPosAttrib->buffer()->Write(0, pMesh->mVertices, v3fsize * numVertices);
 	pDracoExtension->addAttribute(GLTFAttributeType::POSITION, posIndex);
@@ -516,8 +2434,8 @@ Result GLTFExporter::_dracoBuildMesh(const aiMesh* pMesh, draco::Mesh* pDracoMes
 	if (pMesh->HasNormals() && !_options.stripNormals) {
 		GeometryAttribute normalAttribute;
 		normalAttribute.Init(GeometryAttribute::NORMAL, nullptr, 3, draco::DT_FLOAT32, false, v3fsize, 0);
-		int normIndex = pDracoMesh->AddAttribute(normalAttribute, false, numVertices);
-		auto pNormAttrib = pDracoMesh->attribute(normIndex);
+		int normIndex = pDracoGeometry->AddAttribute(normalAttribute, identityMapping, numVertices);
+		auto pNormAttrib = pDracoGeometry->attribute(normIndex);
 		pNormAttrib->Reset(numVertices);
 		pNormAttrib->buffer()->Write(0, pMesh->mNormals, v3fsize * numVertices);
 		pDracoExtension->addAttribute(GLTFAttributeType::NORMAL, normIndex);
@@ -526,32 +2444,49 @@ Result GLTFExporter::_dracoBuildMesh(const aiMesh* pMesh, draco::Mesh* pDracoMes
 		}
 	}
 
+	if (pMesh->HasVertexColors(0)) {
+		// colors are stored as float RGBA and quantized using the generic quantization bits
+		uint32_t v4fsize = sizeof(float) * 4;
+		GeometryAttribute colorAttribute;
+		colorAttribute.Init(GeometryAttribute::COLOR, nullptr, 4, draco::DT_FLOAT32, false, v4fsize, 0);
+		int colorIndex = pDracoGeometry->AddAttribute(colorAttribute, identityMapping, numVertices);
+		auto pColorAttrib = pDracoGeometry->attribute(colorIndex);
+		pColorAttrib->Reset(numVertices);
+		pColorAttrib->buffer()->Write(0, pMesh->mColors[0], v4fsize * numVertices);
+		pDracoExtension->addAttribute(GLTFAttributeType::COLOR_0, colorIndex);
+		if (_options.verbose) {
+			cout << "Color attribute added" << endl;
+		}
+	}
+
+	// custom attributes are stored as generic attributes, quantized using the generic quantization bits
+	for (auto& attrib : _customAttributes) {
+		uint32_t componentSize = uint32_t(attrib.numComponents * sizeof(float));
+		GeometryAttribute genericAttribute;
+		genericAttribute.Init(GeometryAttribute::GENERIC, nullptr, int8_t(attrib.numComponents), draco::DT_FLOAT32, false, componentSize, 0);
+		attrib.dracoId = pDracoGeometry->AddAttribute(genericAttribute, identityMapping, numVertices);
+		auto pGenericAttrib = pDracoGeometry->attribute(attrib.dracoId);
+		pGenericAttrib->Reset(numVertices);
+		pGenericAttrib->buffer()->Write(0, attrib.data.data(), componentSize * numVertices);
+		if (_options.verbose) {
+			cout << "Generic attribute added: " << attrib.name << endl;
+		}
+	}
+
 	if (pMesh->HasTextureCoords(0) && !_options.stripTexCoords) {
-		int texIndex = _dracoAddTexCoords(pMesh, pDracoMesh, 0);
+		int texIndex = _dracoAddTexCoords(pMesh, pDracoGeometry, 0, identityMapping);
 		pDracoExtension->addAttribute(GLTFAttributeType::TEXCOORD_0, texIndex);
 		if (_options.verbose) {
 			cout << "TexCoord 0 attribute added" << endl;
 		}
 	}
 	if (pMesh->HasTextureCoords(1) && !_options.stripTexCoords) {
-		int texIndex = _dracoAddTexCoords(pMesh, pDracoMesh, 1);
+		int texIndex = _dracoAddTexCoords(pMesh, pDracoGeometry, 1, identityMapping);
 		pDracoExtension->addAttribute(GLTFAttributeType::TEXCOORD_1, texIndex);
 		if (_options.verbose) {
 			cout << "TexCoord 1 attribute added" << endl;
 		}
 	}
-
-	Result result = _dracoAddFaces(pMesh, pDracoMesh);
-	if (result.isError()) {
-		return result;
-	}
-
-#ifdef DRACO_ATTRIBUTE_DEDUPLICATION_SUPPORTED
-	pDracoMesh->DeduplicateAttributeValues();
-	pDracoMesh->DeduplicatePointIds();
-#endif
-
-	return Result::ok();
 }
 
 Result GLTFExporter::_dracoAddFaces(const aiMesh* pMesh, draco::Mesh* pDracoMesh)
@@ -589,7 +2524,7 @@ Result GLTFExporter::_dracoAddFaces(const aiMesh* pMesh, draco::Mesh* pDracoMesh
 	return Result::ok();
 }
 
-int GLTFExporter::_dracoAddTexCoords(const aiMesh* pMesh, draco::Mesh* pDracoMesh, uint32_t channel)
+int GLTFExporter::_dracoAddTexCoords(const aiMesh* pMesh, draco::PointCloud* pDracoGeometry, uint32_t channel, bool identityMapping)
 {
 	GeometryAttribute texCoordsAttribute;
 	uint32_t numComponents = pMesh->mNumUVComponents[channel];
@@ -597,8 +2532,8 @@ int GLTFExporter::_dracoAddTexCoords(const aiMesh* pMesh, draco::Mesh* pDracoMes
 	uint32_t numVertices = pMesh->mNumVertices;
 
 	texCoordsAttribute.Init(GeometryAttribute::TEX_COORD, nullptr, numComponents, draco::DT_FLOAT32, false, componentSize, 0);
-	int index = pDracoMesh->AddAttribute(texCoordsAttribute, false, numVertices);
-	auto pTexAttrib = pDracoMesh->attribute(index);
+	int index = pDracoGeometry->AddAttribute(texCoordsAttribute, identityMapping, numVertices);
+	auto pTexAttrib = pDracoGeometry->attribute(index);
 	pTexAttrib->Reset(numVertices);
 
 	// if the assimp mesh's UV channel has 3 components, just copy it to buffer in one go
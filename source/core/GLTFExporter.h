@@ -19,9 +19,18 @@
 #define _MESHSMITH_GLTFEXPORTER_H
 
 #include "library.h"
+#include "CompressedFile.h"
+#include "KtxEncoder.h"
+
 #include "core/ResultT.h"
 #include "core/json.h"
 
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <future>
+
 struct aiScene;
 struct aiMesh;
 struct aiNode;
@@ -29,7 +38,9 @@ struct aiMaterial;
 
 namespace draco
 {
+	class PointCloud;
 	class Mesh;
+	class Encoder;
 	class DataBuffer;
 	class EncoderBuffer;
 }
@@ -39,13 +50,56 @@ namespace flow
 	class GLTFAsset;
 	class GLTFMesh;
 	class GLTFPrimitive;
-	class GLTFBuffer;
+	class GLTFAccessor;
 	class GLTFMaterial;
+	class GLTFTexture;
 	class GLTFDracoExtension;
 }
 
 namespace meshsmith
 {
+	class BinaryBuffer;
+	class BinaryView;
+	class FileSource;
+
+	enum class DracoEncodingMethod { Auto, Edgebreaker, Sequential };
+
+	enum class DracoPredictionScheme {
+		Auto, None, Difference, Parallelogram, MultiParallelogram, TexCoordsPortable, GeometricNormal
+	};
+
+	/// Storage of vertex colors in uncompressed exports, as normalized integers.
+	enum class VertexColorFormat { UInt8, UInt16 };
+
+	/// Storage of normals in uncompressed exports. Octahedral encodings are written to
+	/// the _NORMAL_OCT attribute (and tangents to _TANGENT_OCT), to be decoded in the shader.
+	/// The standard NORMAL attribute is kept, unless octahedral normals only are requested.
+	enum class NormalEncoding { Float, Oct8, Oct16 };
+
+	/// Distribution of binary data over .bin files in glTF (non-binary) exports.
+	enum class BufferGrouping { None, Mesh, Primitive };
+
+	enum class CustomAttributeSource { TexCoords, Colors, File };
+
+	/// Per-vertex channel exported as application-specific attribute (name starting
+	/// with an underscore), e.g. scan confidence, zone IDs or curvature.
+	struct GLTFCustomAttribute
+	{
+		std::string name;
+		CustomAttributeSource source;
+		/// UV or color channel for sources TexCoords and Colors.
+		uint32_t channel;
+		uint32_t numComponents;
+		/// Sidecar file for source File, raw little-endian float32 values, vertex by vertex
+		/// in the order of the input file.
+		std::string file;
+
+		GLTFCustomAttribute() :
+			source(CustomAttributeSource::TexCoords),
+			channel(0),
+			numComponents(1) { }
+	};
+
 	struct GLTFDracoOptions
 	{
 		int positionQuantizationBits;
@@ -54,12 +108,47 @@ namespace meshsmith
 		int genericQuantizationBits;
 		int compressionLevel;
 
+		/// Maximum absolute position error. If greater than zero, the quantization
+		/// bits of all attributes are tuned automatically, the configured bits are
+		/// used as upper bounds.
+		float maxError;
+		/// Maximum position error relative to the bounding box diagonal.
+		/// Used for automatic tuning if maxError is not set.
+		float maxRelativeError;
+		/// Budgets of the other attributes used by automatic tuning, zero keeps the configured bits.
+		/// Maximum angle between a normal and its quantized value in degrees.
+		float maxNormalError;
+		/// Maximum texture coordinate error in UV units.
+		float maxTexCoordError;
+		/// Maximum error of colors and custom attributes relative to the range of their values.
+		float maxGenericError;
+
+		/// Edgebreaker or sequential connectivity encoding. Auto uses the sequential
+		/// encoder for meshes with more than sequentialFaceThreshold faces and for
+		/// poorly connected meshes (triangle soups), as they decode much faster.
+		DracoEncodingMethod encodingMethod;
+		size_t sequentialFaceThreshold;
+
+		DracoPredictionScheme positionPrediction;
+		DracoPredictionScheme normalsPrediction;
+		DracoPredictionScheme texCoordsPrediction;
+
 		GLTFDracoOptions() :
 			positionQuantizationBits(14),
 			texCoordsQuantizationBits(12),
 			normalsQuantizationBits(10),
 			genericQuantizationBits(8),
-			compressionLevel(7)
+			compressionLevel(7),
+			maxError(0.0f),
+			maxRelativeError(0.0f),
+			maxNormalError(0.5f),
+			maxTexCoordError(0.00025f),
+			maxGenericError(0.002f),
+			encodingMethod(DracoEncodingMethod::Auto),
+			sequentialFaceThreshold(1000000),
+			positionPrediction(DracoPredictionScheme::Auto),
+			normalsPrediction(DracoPredictionScheme::Auto),
+			texCoordsPrediction(DracoPredictionScheme::Auto)
 		{
 		}
 	};
@@ -73,6 +162,57 @@ namespace meshsmith
 		bool stripNormals;
 		bool stripTexCoords;
 		bool writeBinary;
+		/// Store positions, normals and UVs in a single interleaved buffer view (uncompressed only).
+		bool interleaved;
+		/// Split meshes with more than 65535 vertices into spatially coherent
+		/// chunks with 16 bit indices, one primitive each (uncompressed only).
+		bool splitMeshes;
+
+		VertexColorFormat colorFormat;
+		NormalEncoding normalEncoding;
+		/// Omit NORMAL with octahedral encodings, for viewers decoding _NORMAL_OCT only.
+		/// Standard glTF viewers render such assets without normals.
+		bool octNormalsOnly;
+
+		/// Index of the scene mesh to export, the exporter writes a single mesh.
+		size_t meshIndex;
+
+		/// Maximum size of a binary buffer in bytes, 0 = 4GB minus room for the GLB header.
+		/// Larger data is distributed over several buffers, stored in .bin files.
+		size_t maxBufferSize;
+		/// Write a separate .bin file per mesh or primitive (plus one for embedded maps),
+		/// so viewers can fetch only what they draw. glTF only, GLB output ignores it.
+		BufferGrouping bufferGrouping;
+		/// Order the binary data for progressive download: geometry for a first render and
+		/// small maps first, then remaining attributes and large maps, each stage 4KB aligned.
+		bool progressiveLayout;
+		/// Write gzip and/or brotli compressed copies of all output files.
+		Precompression precompression;
+		/// Transcode maps to KTX2 with mipmaps (KHR_texture_basisu). The zone map holds IDs
+		/// and is never compressed.
+		TextureCompression textureCompression;
+		/// Re-encode maps as WebP (EXT_texture_webp), normal and zone maps lossless.
+		/// Takes precedence over textureCompression.
+		bool webpMaps;
+		/// WebP quality of the lossy maps, 0 - 100.
+		float webpQuality;
+		/// Keep the original JPEG/PNG maps as fallback for viewers without WebP support.
+		bool webpFallback;
+		/// Maximum width and height per map ("diffuse", "occlusion", "emissive", "metallicRoughness",
+		/// "zone", "normal"), larger maps are scaled down keeping their aspect ratio. 0 or absent keeps the size.
+		std::map<std::string, uint32_t> maxMapSizes;
+		/// Maximum number of pixels of a map that is decoded for processing, larger maps are
+		/// scaled down to fit while decoding, which bounds the memory used per map. 0 = no limit.
+		/// Maps embedded or written as they are aren't decoded and keep their size.
+		uint64_t maxMapPixels;
+		/// Write half-size levels of each map down to 64 pixels, listed in the image's extras
+		/// as "mipmaps" for viewers streaming maps progressively, standard loaders ignore them.
+		/// Each level has width, height and a uri or bufferView and mimeType, ordered from half
+		/// size down. KTX2 maps carry their own mipmaps, zone maps get none.
+		bool mapMipmaps;
+		/// JSON file caching the content hashes of the maps across jobs. Maps with identical
+		/// content share one texture, the cache avoids hashing unchanged files again.
+		std::string hashCacheFile;
 
 		float metallicFactor;
 		float roughnessFactor;
@@ -84,6 +224,8 @@ namespace meshsmith
 		std::string zoneMapFile;
 		std::string normalMapFile;
 
+		std::vector<GLTFCustomAttribute> customAttributes;
+
 		GLTFDracoOptions draco;
 
 		GLTFExporterOptions() :
@@ -94,6 +236,22 @@ namespace meshsmith
 			stripNormals(false),
 			stripTexCoords(false),
 			writeBinary(false),
+			interleaved(false),
+			splitMeshes(false),
+			colorFormat(VertexColorFormat::UInt8),
+			normalEncoding(NormalEncoding::Float),
+			octNormalsOnly(false),
+			meshIndex(0),
+			maxBufferSize(0),
+			bufferGrouping(BufferGrouping::None),
+			progressiveLayout(false),
+			precompression(Precompression::None),
+			textureCompression(TextureCompression::None),
+			webpMaps(false),
+			webpQuality(80.0f),
+			webpFallback(false),
+			maxMapPixels(8192 * 8192),
+			mapMipmaps(false),
 			metallicFactor(0.1f),
 			roughnessFactor(0.8f) { }
 	};
@@ -111,31 +269,201 @@ namespace meshsmith
 		/// the previously set export options.
 		flow::Result exportScene(const aiScene* pScene, const std::string& fileName);
 
+		/// Returns information about the last export, e.g. the quantization
+		/// settings chosen by automatic tuning.
+		flow::json getJsonReport() const;
+
 	protected:
 		typedef flow::ResultT<flow::GLTFMaterial*> materialResult_t;
 
+		struct customAttributeData_t
+		{
+			std::string name;
+			size_t numComponents;
+			std::vector<float> data;
+			int dracoId;
+		};
+
+		struct customAttributeRef_t
+		{
+			size_t meshIndex;
+			size_t primitiveIndex;
+			std::string name;
+			size_t accessorIndex;
+			int dracoId;
+			/// Merged into the primitive's extras.
+			flow::json extras;
+		};
+
+		/// Buffer view references, patched into the asset JSON after layout.
+		struct accessorViewRef_t
+		{
+			size_t accessorIndex;
+			size_t viewIndex;
+			size_t byteOffset;
+		};
+
+		struct textureViewRef_t
+		{
+			size_t textureIndex;
+			size_t viewIndex;
+			std::string mimeType;
+		};
+
+		/// Part of a split mesh, with the original index of each vertex.
+		struct meshChunk_t
+		{
+			std::shared_ptr<aiMesh> pMesh;
+			std::vector<uint32_t> vertexMap;
+		};
+
+		/// Encoded image, written next to the glTF file unless maps are embedded.
+		struct encodedImage_t
+		{
+			std::shared_ptr<std::vector<uint8_t>> pData;
+			std::string filePath;
+			size_t width;
+			size_t height;
+		};
+
+		/// Map that has been resized and/or encoded as KTX2 or WebP, decoded once for all outputs.
+		struct processedTexture_t
+		{
+			std::string sourceFile;
+			std::string mapName;
+			/// KHR_texture_basisu or EXT_texture_webp, empty if the map keeps its format.
+			std::string extension;
+			encodedImage_t image;
+			/// Resized map in its original format for viewers without the extension,
+			/// if pData is null the original file is used.
+			encodedImage_t fallback;
+			std::vector<encodedImage_t> mipmaps;
+		};
+
+		/// Texture with an image referenced through an extension and/or with mipmap levels.
+		struct textureImageRef_t
+		{
+			size_t textureIndex;
+			std::string extension;
+			/// Image added for the extension, the texture's own image is kept as fallback.
+			/// If null, the texture's image is moved to the extension.
+			flow::json image;
+			/// Levels listed in the extras of the extension's image, or else the texture's image.
+			flow::json mipmaps;
+		};
+
+		struct dracoViewRef_t
+		{
+			size_t meshIndex;
+			size_t primitiveIndex;
+			size_t viewIndex;
+		};
+
+		/// Quantization bits of the attribute types quantized by Draco, colors use the generic bits.
+		struct dracoQuantization_t
+		{
+			int positionBits;
+			int normalsBits;
+			int texCoordsBits;
+			int genericBits;
+		};
+
 		flow::ResultT<flow::GLTFMesh*> _exportMesh(
-			const aiScene* pAiScene, size_t meshIndex, flow::GLTFAsset& asset, flow::GLTFBuffer* pBuffer);
+			const aiScene* pAiScene, size_t meshIndex, flow::GLTFAsset& asset, BinaryBuffer* pBuffer);
+
+		flow::Result _exportPrimitive(const aiMesh* pAiMesh, flow::GLTFAsset& asset, flow::GLTFMesh* pMesh,
+			size_t primitiveIndex, BinaryBuffer* pBuffer, const std::vector<uint32_t>* pVertexMap);
+
+		flow::Result _splitMesh(const aiMesh* pAiMesh, std::vector<meshChunk_t>& chunks) const;
 
 		template<typename T>
 		flow::Result _exportFaces(const aiMesh* pAiMesh, flow::GLTFAsset& asset,
-			flow::GLTFPrimitive& primitive, flow::GLTFBuffer* pBuffer);
+			flow::GLTFPrimitive& primitive, BinaryBuffer* pBuffer);
 		
 		void _exportTexCoords(
 			const aiMesh* pAiMesh, flow::GLTFAsset& asset,
-			flow::GLTFPrimitive& primitive, flow::GLTFBuffer* pBuffer, int channel);
+			flow::GLTFPrimitive& primitive, BinaryBuffer* pBuffer, int channel);
+
+		void _exportInterleaved(const aiMesh* pAiMesh, flow::GLTFAsset& asset,
+			flow::GLTFPrimitive& primitive, BinaryBuffer* pBuffer);
+
+		template<typename T>
+		void _exportColors(const aiMesh* pAiMesh, flow::GLTFAsset& asset,
+			flow::GLTFPrimitive& primitive, BinaryBuffer* pBuffer);
+
+		bool _exportFloatNormals() const;
+		template<typename T>
+		void _exportOctahedral(const aiMesh* pAiMesh, flow::GLTFAsset& asset,
+			flow::GLTFMesh* pMesh, size_t primitiveIndex, BinaryBuffer* pBuffer);
+
+		flow::Result _loadCustomAttributes(const aiMesh* pAiMesh);
+		void _exportCustomAttributes(const aiMesh* pAiMesh, flow::GLTFAsset& asset, flow::GLTFMesh* pMesh,
+			size_t primitiveIndex, BinaryBuffer* pBuffer, const std::vector<uint32_t>* pVertexMap);
 
 		materialResult_t _exportMaterial(
-			const aiScene* pAiScene, size_t meshIndex, flow::GLTFAsset& asset, flow::GLTFBuffer* pBuffer);
+			const aiScene* pAiScene, size_t meshIndex, flow::GLTFAsset& asset, BinaryBuffer* pBuffer);
+
+		materialResult_t _createDefaultMaterial(flow::GLTFAsset& asset, BinaryBuffer* pBuffer);
+		flow::GLTFTexture* _createEmbeddedTexture(flow::GLTFAsset& asset, BinaryView* pView, const std::string& filePath);
+		/// Creates the texture for the given map file, embedded or referenced, using its
+		/// resized, KTX2 or WebP version if available.
+		flow::ResultT<flow::GLTFTexture*> _createMapTexture(flow::GLTFAsset& asset, BinaryBuffer* pBuffer,
+			const std::string& mapFile, const std::string& mapName, TextureUsage usage);
+		flow::GLTFTexture* _createEncodedTexture(flow::GLTFAsset& asset, BinaryBuffer* pBuffer, const encodedImage_t& image);
+		flow::json _encodedImageToJSON(BinaryBuffer* pBuffer, const encodedImage_t& image);
+		/// Hashes, resizes and encodes the maps, and starts reading the map files embedded as they are.
+		/// Runs while the geometry is encoded.
+		flow::Result _prepareMaps(const std::string& outputDir);
+		/// Hashes the map files and records maps with identical content as aliases of the first one.
+		flow::Result _deduplicateMaps();
+		/// Returns the encoded image used as the texture's source, or nullptr if the map file is used as is.
+		const encodedImage_t* _textureSource(const processedTexture_t* pProcessed) const;
+		/// Returns the first map file with the same content as the given one.
+		const std::string& _mapFile(const std::string& filePath) const;
+		/// Maps with the same key share one texture.
+		std::string _textureKey(const std::string& filePath, TextureUsage usage) const;
+		/// Resizes and encodes the maps in parallel, each map is decoded once.
+		flow::Result _processTextures(const std::string& outputDir);
+
+		void _setAccessorView(const flow::GLTFAccessor* pAccessor, const BinaryView* pView, size_t byteOffset = 0);
 
-		materialResult_t _createDefaultMaterial(flow::GLTFAsset& asset, flow::GLTFBuffer* pBuffer);
+		flow::json _assetToJSON(const flow::GLTFAsset& asset,
+			const BinaryBuffer* pBuffer, const std::vector<std::string>& bufferUris) const;
+		size_t _layoutBuffers(BinaryBuffer* pBuffer, bool separateGroups) const;
+		flow::Result _writeBuffers(const BinaryBuffer* pBuffer, size_t firstBuffer, const std::string& binaryBasePath) const;
+		flow::Result _writeGLB(const BinaryBuffer* pBuffer,
+			const std::string& filePath, const std::string& jsonText, size_t totalLength) const;
+		flow::Result _saveGLB(const flow::GLTFAsset& asset, BinaryBuffer* pBuffer,
+			const std::string& filePath, const std::string& binaryBasePath) const;
+		flow::Result _saveGLTF(const flow::GLTFAsset& asset, BinaryBuffer* pBuffer,
+			const std::string& filePath, const std::string& binaryBasePath) const;
 
-		flow::Result _dracoCompressMesh(const aiMesh* pMesh, flow::GLTFDracoExtension* pDracoExtension, flow::GLTFBuffer* pBuffer);
+		flow::ResultT<BinaryView*> _dracoCompressMesh(const aiMesh* pMesh, flow::GLTFDracoExtension* pDracoExtension, BinaryBuffer* pBuffer);
 		flow::Result _dracoBuildMesh(const aiMesh* pMesh, draco::Mesh* pDracoMesh, flow::GLTFDracoExtension* pDracoExtension);
+		flow::Result _dracoBuildPointCloud(const aiMesh* pMesh, draco::PointCloud* pDracoPointCloud, flow::GLTFDracoExtension* pDracoExtension);
+		void _dracoAddAttributes(const aiMesh* pMesh, draco::PointCloud* pDracoGeometry, flow::GLTFDracoExtension* pDracoExtension, bool identityMapping);
 		flow::Result _dracoAddFaces(const aiMesh* pMesh, draco::Mesh* pDracoMesh);
-		int _dracoAddTexCoords(const aiMesh* pMesh, draco::Mesh* pDracoMesh, uint32_t channel);
+		int _dracoAddTexCoords(const aiMesh* pMesh, draco::PointCloud* pDracoGeometry, uint32_t channel, bool identityMapping);
+		flow::Result _dracoSetupEncoder(draco::Encoder& encoder, const aiMesh* pMesh, const dracoQuantization_t& quantization) const;
+		bool _dracoUseSequentialEncoding(const aiMesh* pMesh) const;
+		flow::ResultT<dracoQuantization_t> _dracoEncodeAuto(const aiMesh* pMesh, const draco::PointCloud& dracoGeometry, draco::EncoderBuffer& encoderBuffer);
 
 		GLTFExporterOptions _options;
+		flow::json _report;
+
+		std::vector<customAttributeData_t> _customAttributes;
+		std::vector<customAttributeRef_t> _customAttributeRefs;
+		std::vector<std::shared_ptr<aiMesh>> _chunkMeshes;
+
+		std::vector<accessorViewRef_t> _accessorViewRefs;
+		std::vector<textureViewRef_t> _textureViewRefs;
+		std::vector<dracoViewRef_t> _dracoViewRefs;
+
+		std::map<std::string, std::string> _mapFileAliases;
+		std::map<std::string, std::shared_future<std::shared_ptr<FileSource>>> _mapSources;
+		std::map<std::string, flow::GLTFTexture*> _mapTextures;
+		std::map<std::string, processedTexture_t> _processedTextures;
+		std::vector<textureImageRef_t> _textureImageRefs;
 	};
 }
 
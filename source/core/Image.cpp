@@ -0,0 +1,951 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Image.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#if defined(MESHSMITH_HAS_PNG)
+# include <png.h>
+#endif
+
+#if defined(MESHSMITH_HAS_JPEG)
+# include <csetjmp>
+# include <jpeglib.h>
+#endif
+
+#if defined(MESHSMITH_HAS_WEBP)
+# include <webp/encode.h>
+#endif
+
+using namespace meshsmith;
+using namespace flow;
+
+// destination rows resampled together, bounds the intermediate buffer of the separable filter
+static const size_t _resampleBandHeight = 16;
+
+namespace {
+	enum class ImageFormat { Unknown, PNG, JPEG };
+
+	/// Source pixel and weight contributing to a destination pixel.
+	struct tap_t
+	{
+		size_t index;
+		float weight;
+	};
+
+	/// Filter taps of one axis, the taps of destination pixel i are taps[offsets[i]] to taps[offsets[i + 1]].
+	struct axisFilter_t
+	{
+		std::vector<tap_t> taps;
+		std::vector<size_t> offsets;
+	};
+}
+
+static ImageFormat _formatFromExtension(const std::string& filePath)
+{
+	size_t dotPos = filePath.find_last_of(".");
+	std::string extension = dotPos == std::string::npos ? std::string() : filePath.substr(dotPos + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	if (extension == "png") {
+		return ImageFormat::PNG;
+	}
+	if (extension == "jpg" || extension == "jpeg") {
+		return ImageFormat::JPEG;
+	}
+
+	return ImageFormat::Unknown;
+}
+
+/// Box filter when downscaling, bilinear interpolation when upscaling, or nearest neighbor.
+static axisFilter_t _createAxisFilter(size_t sourceSize, size_t size, ImageFilter imageFilter)
+{
+	axisFilter_t filter;
+	float scale = float(sourceSize) / float(size);
+
+	for (size_t i = 0; i < size; ++i) {
+		filter.offsets.push_back(filter.taps.size());
+
+		if (imageFilter == ImageFilter::Nearest) {
+			tap_t tap = { std::min(size_t((i + 0.5f) * scale), sourceSize - 1), 1.0f };
+			filter.taps.push_back(tap);
+		}
+		else if (scale > 1.0f) {
+			float start = i * scale;
+			float end = start + scale;
+			size_t first = size_t(start);
+			size_t last = std::min(size_t(std::ceil(end)), sourceSize);
+
+			for (size_t j = first; j < last; ++j) {
+				float overlap = std::min(end, float(j + 1)) - std::max(start, float(j));
+				if (overlap > 0.0f) {
+					tap_t tap = { j, overlap / scale };
+					filter.taps.push_back(tap);
+				}
+			}
+		}
+		else {
+			float center = std::max((i + 0.5f) * scale - 0.5f, 0.0f);
+			size_t first = std::min(size_t(center), sourceSize - 1);
+			size_t second = std::min(first + 1, sourceSize - 1);
+			float fraction = center - float(first);
+
+			tap_t tap0 = { first, 1.0f - fraction };
+			tap_t tap1 = { second, fraction };
+			filter.taps.push_back(tap0);
+			filter.taps.push_back(tap1);
+		}
+	}
+
+	filter.offsets.push_back(filter.taps.size());
+	return filter;
+}
+
+/// Converts a pixel with the given number of channels to RGBA.
+static void _toRGBA(const float* pPixel, size_t channels, float* pRGBA)
+{
+	switch (channels) {
+	case 1:
+		pRGBA[0] = pRGBA[1] = pRGBA[2] = pPixel[0];
+		pRGBA[3] = 255.0f;
+		break;
+	case 2:
+		pRGBA[0] = pRGBA[1] = pRGBA[2] = pPixel[0];
+		pRGBA[3] = pPixel[1];
+		break;
+	case 3:
+		pRGBA[0] = pPixel[0];
+		pRGBA[1] = pPixel[1];
+		pRGBA[2] = pPixel[2];
+		pRGBA[3] = 255.0f;
+		break;
+	default:
+		pRGBA[0] = pPixel[0];
+		pRGBA[1] = pPixel[1];
+		pRGBA[2] = pPixel[2];
+		pRGBA[3] = pPixel[3];
+		break;
+	}
+}
+
+/// Converts an RGBA pixel to the given number of channels, gray is taken from the red channel.
+static void _fromRGBA(const float* pRGBA, size_t channels, uint8_t* pPixel)
+{
+	uint8_t rgba[4];
+	for (size_t i = 0; i < 4; ++i) {
+		rgba[i] = uint8_t(std::min(std::max(pRGBA[i] + 0.5f, 0.0f), 255.0f));
+	}
+
+	switch (channels) {
+	case 1:
+		pPixel[0] = rgba[0];
+		break;
+	case 2:
+		pPixel[0] = rgba[0];
+		pPixel[1] = rgba[3];
+		break;
+	default:
+		memcpy(pPixel, rgba, channels);
+		break;
+	}
+}
+
+#if defined(MESHSMITH_HAS_JPEG)
+namespace {
+	/// libjpeg exits on errors by default, return to the caller instead.
+	struct jpegErrorManager_t
+	{
+		jpeg_error_mgr manager;
+		jmp_buf jump;
+		char message[JMSG_LENGTH_MAX];
+	};
+}
+
+static void _jpegErrorExit(j_common_ptr pInfo)
+{
+	jpegErrorManager_t* pError = (jpegErrorManager_t*)pInfo->err;
+	(*pInfo->err->format_message)(pInfo, pError->message);
+	longjmp(pError->jump, 1);
+}
+#endif
+
+#if defined(MESHSMITH_HAS_PNG)
+/// libpng prints errors and warnings by default, keep the error message for the caller instead.
+static void _pngError(png_structp pPng, png_const_charp pMessage)
+{
+	*(std::string*)png_get_error_ptr(pPng) = pMessage;
+	png_longjmp(pPng, 1);
+}
+
+static void _pngWarning(png_structp, png_const_charp)
+{
+}
+#endif
+
+namespace {
+	/// Decodes an image file row by row, so only a band of rows needs to be in memory.
+	struct rowReader_t
+	{
+		size_t width = 0;
+		size_t height = 0;
+		size_t channels = 0;
+		std::string error;
+
+		virtual ~rowReader_t() { }
+		/// Decodes the next count rows into pRows, returns false on errors.
+		virtual bool readRows(uint8_t* pRows, size_t count) = 0;
+	};
+
+#if defined(MESHSMITH_HAS_PNG)
+	struct pngRowReader_t : public rowReader_t
+	{
+		FILE* pFile = nullptr;
+		png_structp pPng = nullptr;
+		png_infop pInfo = nullptr;
+
+		virtual ~pngRowReader_t()
+		{
+			if (pPng) {
+				png_destroy_read_struct(&pPng, pInfo ? &pInfo : nullptr, nullptr);
+			}
+			if (pFile) {
+				fclose(pFile);
+			}
+		}
+
+		/// Reads the header. Interlaced images are stored in passes over the whole
+		/// image and can't be decoded row by row.
+		bool open(const std::string& filePath, bool& isInterlaced)
+		{
+			pFile = fopen(filePath.c_str(), "rb");
+			pPng = pFile ? png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, _pngError, _pngWarning) : nullptr;
+			pInfo = pPng ? png_create_info_struct(pPng) : nullptr;
+			if (!pInfo) {
+				error = pFile ? "out of memory" : "failed to open file";
+				return false;
+			}
+
+			if (setjmp(png_jmpbuf(pPng))) {
+				return false;
+			}
+
+			png_init_io(pPng, pFile);
+			png_read_info(pPng, pInfo);
+
+			// same channels as _loadPNG: palette images to RGB, transparency to alpha, 16 bit to 8 bit
+			png_set_expand(pPng);
+			png_set_strip_16(pPng);
+			isInterlaced = png_set_interlace_handling(pPng) > 1;
+			png_read_update_info(pPng, pInfo);
+
+			width = png_get_image_width(pPng, pInfo);
+			height = png_get_image_height(pPng, pInfo);
+			channels = png_get_channels(pPng, pInfo);
+			return true;
+		}
+
+		virtual bool readRows(uint8_t* pRows, size_t count) override
+		{
+			if (setjmp(png_jmpbuf(pPng))) {
+				return false;
+			}
+
+			for (size_t i = 0; i < count; ++i) {
+				png_read_row(pPng, pRows + i * width * channels, nullptr);
+			}
+			return true;
+		}
+	};
+#endif
+
+#if defined(MESHSMITH_HAS_JPEG)
+	struct jpegRowReader_t : public rowReader_t
+	{
+		FILE* pFile = nullptr;
+		jpeg_decompress_struct info;
+		jpegErrorManager_t errorManager;
+		bool isCreated = false;
+
+		virtual ~jpegRowReader_t()
+		{
+			if (isCreated) {
+				jpeg_destroy_decompress(&info);
+			}
+			if (pFile) {
+				fclose(pFile);
+			}
+		}
+
+		/// Reads the header and starts decoding at 1 / scaleDenominator (1, 2, 4 or 8) of the
+		/// full size. The decoder reduces the size in the DCT, at a fraction of the cost.
+		bool open(const std::string& filePath, unsigned int scaleDenominator)
+		{
+			pFile = fopen(filePath.c_str(), "rb");
+			if (!pFile) {
+				error = "failed to open file";
+				return false;
+			}
+
+			info.err = jpeg_std_error(&errorManager.manager);
+			errorManager.manager.error_exit = _jpegErrorExit;
+
+			if (setjmp(errorManager.jump)) {
+				error = errorManager.message;
+				return false;
+			}
+
+			jpeg_create_decompress(&info);
+			isCreated = true;
+			jpeg_stdio_src(&info, pFile);
+			jpeg_read_header(&info, TRUE);
+
+			info.out_color_space = info.num_components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+			info.scale_num = 1;
+			info.scale_denom = scaleDenominator;
+			jpeg_start_decompress(&info);
+
+			width = info.output_width;
+			height = info.output_height;
+			channels = info.output_components;
+			return true;
+		}
+
+		virtual bool readRows(uint8_t* pRows, size_t count) override
+		{
+			if (setjmp(errorManager.jump)) {
+				error = errorManager.message;
+				return false;
+			}
+
+			for (size_t i = 0; i < count; ++i) {
+				JSAMPROW pRow = pRows + i * width * channels;
+				jpeg_read_scanlines(&info, &pRow, 1);
+			}
+			return true;
+		}
+	};
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Image::Image() :
+	_width(0),
+	_height(0),
+	_channels(0)
+{
+}
+
+Image::Image(size_t width, size_t height, size_t channels) :
+	_width(width),
+	_height(height),
+	_channels(channels),
+	_pixels(width * height * channels, 0)
+{
+}
+
+bool Image::isSupported(const std::string& filePath)
+{
+	switch (_formatFromExtension(filePath)) {
+#if defined(MESHSMITH_HAS_PNG)
+	case ImageFormat::PNG:
+		return true;
+#endif
+#if defined(MESHSMITH_HAS_JPEG)
+	case ImageFormat::JPEG:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+bool Image::isWebPSupported()
+{
+#if defined(MESHSMITH_HAS_WEBP)
+	return true;
+#else
+	return false;
+#endif
+}
+
+Result Image::readInfo(const std::string& filePath, size_t& width, size_t& height, size_t& channels)
+{
+	switch (_formatFromExtension(filePath)) {
+#if defined(MESHSMITH_HAS_PNG)
+	case ImageFormat::PNG: {
+		png_image image;
+		memset(&image, 0, sizeof(image));
+		image.version = PNG_IMAGE_VERSION;
+
+		if (!png_image_begin_read_from_file(&image, filePath.c_str())) {
+			return Result::error("failed to read PNG file: " + filePath + ", reason: " + image.message);
+		}
+
+		width = image.width;
+		height = image.height;
+		channels = ((image.format & PNG_FORMAT_FLAG_COLOR) ? 3 : 1) + ((image.format & PNG_FORMAT_FLAG_ALPHA) ? 1 : 0);
+		png_image_free(&image);
+		return Result::ok();
+	}
+#endif
+#if defined(MESHSMITH_HAS_JPEG)
+	case ImageFormat::JPEG: {
+		Image image;
+		Result result = image._loadJPEG(filePath, true);
+		width = image._width;
+		height = image._height;
+		channels = image._channels;
+		return result;
+	}
+#endif
+	default:
+		return Result::error("unsupported image format: " + filePath);
+	}
+}
+
+Result Image::load(const std::string& filePath)
+{
+	switch (_formatFromExtension(filePath)) {
+	case ImageFormat::PNG:
+		return _loadPNG(filePath);
+	case ImageFormat::JPEG:
+		return _loadJPEG(filePath);
+	default:
+		return Result::error("unsupported image format: " + filePath);
+	}
+}
+
+Result Image::loadScaled(const std::string& filePath, size_t maxSize, ImageFilter filter, size_t numThreads)
+{
+	size_t sourceWidth, sourceHeight, channels;
+	Result result = maxSize > 0 ? readInfo(filePath, sourceWidth, sourceHeight, channels) : Result::ok();
+	if (result.isError()) {
+		return result;
+	}
+
+	if (maxSize == 0 || std::max(sourceWidth, sourceHeight) <= maxSize) {
+		return load(filePath);
+	}
+
+	double scale = double(maxSize) / double(std::max(sourceWidth, sourceHeight));
+	size_t width = std::max(size_t(std::lround(sourceWidth * scale)), size_t(1));
+	size_t height = std::max(size_t(std::lround(sourceHeight * scale)), size_t(1));
+
+	std::unique_ptr<rowReader_t> pReader;
+
+	switch (_formatFromExtension(filePath)) {
+#if defined(MESHSMITH_HAS_PNG)
+	case ImageFormat::PNG: {
+		pngRowReader_t* pPngReader = new pngRowReader_t();
+		pReader.reset(pPngReader);
+
+		bool isInterlaced = false;
+		if (!pPngReader->open(filePath, isInterlaced)) {
+			return Result::error("failed to read PNG file: " + filePath + ", reason: " + pReader->error);
+		}
+		if (isInterlaced) {
+			pReader.reset();
+			result = load(filePath);
+			if (result.isError()) {
+				return result;
+			}
+			*this = resized(width, height, filter);
+			return Result::ok();
+		}
+		break;
+	}
+#endif
+#if defined(MESHSMITH_HAS_JPEG)
+	case ImageFormat::JPEG: {
+		// DCT scaling averages pixels, it is used for smooth filtering only
+		unsigned int scaleDenominator = 1;
+		while (filter == ImageFilter::Smooth && scaleDenominator < 8
+				&& sourceWidth / (scaleDenominator * 2) >= width && sourceHeight / (scaleDenominator * 2) >= height) {
+			scaleDenominator *= 2;
+		}
+
+		jpegRowReader_t* pJpegReader = new jpegRowReader_t();
+		pReader.reset(pJpegReader);
+
+		if (!pJpegReader->open(filePath, scaleDenominator)) {
+			return Result::error("failed to read JPEG file: " + filePath + ", reason: " + pReader->error);
+		}
+		break;
+	}
+#endif
+	default:
+		return Result::error("unsupported image format: " + filePath);
+	}
+
+	sourceWidth = pReader->width;
+	sourceHeight = pReader->height;
+	channels = pReader->channels;
+
+	axisFilter_t filterX = _createAxisFilter(sourceWidth, width, filter);
+	axisFilter_t filterY = _createAxisFilter(sourceHeight, height, filter);
+
+	// source rows sampled by the vertical filter, nearest neighbor skips most
+	std::vector<bool> isSampled(sourceHeight, false);
+	for (const auto& tap : filterY.taps) {
+		isSampled[tap.index] = true;
+	}
+
+	_width = width;
+	_height = height;
+	_channels = channels;
+	_pixels.assign(width * height * channels, 0);
+
+	const size_t sourceRowLength = sourceWidth * channels;
+	const size_t rowLength = width * channels;
+
+	// the working set is a band of decoded source rows plus the horizontally filtered rows
+	// covered by the next output row, independent of the source image size; each thread
+	// filters a slice of the band, so threads are started once per band
+	const size_t bandHeight = std::max(numThreads, size_t(1)) * _resampleBandHeight;
+	std::vector<uint8_t> band(bandHeight * sourceRowLength);
+	std::vector<float*> bandRows(bandHeight);
+	std::map<size_t, std::vector<float>> window;
+	std::vector<float> pixels(rowLength);
+	size_t row = 0;
+
+	for (size_t bandBegin = 0; bandBegin < sourceHeight && row < height; bandBegin += bandHeight) {
+		size_t bandEnd = std::min(bandBegin + bandHeight, sourceHeight);
+
+		if (!pReader->readRows(band.data(), bandEnd - bandBegin)) {
+			return Result::error("failed to read image file: " + filePath + ", reason: " + pReader->error);
+		}
+
+		for (size_t sourceRow = bandBegin; sourceRow < bandEnd; ++sourceRow) {
+			std::vector<float>* pRow = isSampled[sourceRow] ? &window[sourceRow] : nullptr;
+			if (pRow) {
+				pRow->assign(rowLength, 0.0f);
+			}
+			bandRows[sourceRow - bandBegin] = pRow ? pRow->data() : nullptr;
+		}
+
+		parallelFor(0, bandEnd - bandBegin, [&](size_t blockBegin, size_t blockEnd) {
+			for (size_t i = blockBegin; i < blockEnd; ++i) {
+				float* pDst = bandRows[i];
+				if (!pDst) {
+					continue;
+				}
+
+				const uint8_t* pSrc = band.data() + i * sourceRowLength;
+				for (size_t x = 0; x < width; ++x, pDst += channels) {
+					for (size_t t = filterX.offsets[x]; t < filterX.offsets[x + 1]; ++t) {
+						const uint8_t* pPixel = pSrc + filterX.taps[t].index * channels;
+						float weight = filterX.taps[t].weight;
+						for (size_t c = 0; c < channels; ++c) {
+							pDst[c] += pPixel[c] * weight;
+						}
+					}
+				}
+			}
+		}, _resampleBandHeight);
+
+		// output rows whose taps have all been decoded
+		while (row < height && filterY.taps[filterY.offsets[row + 1] - 1].index < bandEnd) {
+			std::fill(pixels.begin(), pixels.end(), 0.0f);
+
+			for (size_t t = filterY.offsets[row]; t < filterY.offsets[row + 1]; ++t) {
+				const float* pRow = window[filterY.taps[t].index].data();
+				float weight = filterY.taps[t].weight;
+				for (size_t i = 0; i < rowLength; ++i) {
+					pixels[i] += pRow[i] * weight;
+				}
+			}
+
+			uint8_t* pDst = _pixels.data() + row * rowLength;
+			for (size_t i = 0; i < rowLength; ++i) {
+				pDst[i] = uint8_t(std::min(std::max(pixels[i] + 0.5f, 0.0f), 255.0f));
+			}
+
+			if (++row < height) {
+				window.erase(window.begin(), window.lower_bound(filterY.taps[filterY.offsets[row]].index));
+			}
+		}
+	}
+
+	return Result::ok();
+}
+
+Result Image::save(const std::string& filePath, int jpegQuality) const
+{
+	std::vector<uint8_t> data;
+	Result result = encode(filePath, data, jpegQuality);
+	if (result.isError()) {
+		return Result::error(result.message() + ": " + filePath);
+	}
+
+	FILE* pFile = fopen(filePath.c_str(), "wb");
+	if (!pFile) {
+		return Result::error("failed to create image file: " + filePath);
+	}
+
+	size_t written = fwrite(data.data(), 1, data.size(), pFile);
+	if (fclose(pFile) != 0 || written != data.size()) {
+		return Result::error("failed to write image file: " + filePath);
+	}
+
+	return Result::ok();
+}
+
+Result Image::encode(const std::string& filePath, std::vector<uint8_t>& data, int jpegQuality) const
+{
+	switch (_formatFromExtension(filePath)) {
+	case ImageFormat::PNG:
+		return _encodePNG(data);
+	case ImageFormat::JPEG:
+		return _encodeJPEG(data, jpegQuality);
+	default:
+		return Result::error("unsupported image format");
+	}
+}
+
+Result Image::encodeWebP(float quality, bool lossless, std::vector<uint8_t>& webpData) const
+{
+#if defined(MESHSMITH_HAS_WEBP)
+	// WebP encodes RGB or RGBA, gray images are expanded
+	const uint8_t* pPixels = _pixels.data();
+	std::vector<uint8_t> expanded;
+	size_t channels = _channels;
+
+	if (_channels < 3) {
+		channels = _channels + 2;
+		expanded.resize(_width * _height * channels);
+		for (size_t i = 0, n = _width * _height; i < n; ++i) {
+			const uint8_t* pSrc = pPixels + i * _channels;
+			uint8_t* pDst = expanded.data() + i * channels;
+			pDst[0] = pDst[1] = pDst[2] = pSrc[0];
+			if (_channels == 2) {
+				pDst[3] = pSrc[1];
+			}
+		}
+		pPixels = expanded.data();
+	}
+
+	int width = int(_width);
+	int height = int(_height);
+	int stride = int(_width * channels);
+	uint8_t* pOutput = nullptr;
+	size_t size = 0;
+
+	if (channels == 4) {
+		size = lossless
+			? WebPEncodeLosslessRGBA(pPixels, width, height, stride, &pOutput)
+			: WebPEncodeRGBA(pPixels, width, height, stride, quality, &pOutput);
+	}
+	else {
+		size = lossless
+			? WebPEncodeLosslessRGB(pPixels, width, height, stride, &pOutput)
+			: WebPEncodeRGB(pPixels, width, height, stride, quality, &pOutput);
+	}
+
+	if (size == 0) {
+		WebPFree(pOutput);
+		return Result::error("failed to encode WebP image");
+	}
+
+	webpData.assign(pOutput, pOutput + size);
+	WebPFree(pOutput);
+	return Result::ok();
+#else
+	return Result::error("WebP support not available in this build");
+#endif
+}
+
+void Image::fill(size_t x, size_t y, size_t width, size_t height, const uint8_t* pColor)
+{
+	size_t xEnd = std::min(x + width, _width);
+	size_t yEnd = std::min(y + height, _height);
+
+	for (size_t row = y; row < yEnd; ++row) {
+		uint8_t* pDst = _pixels.data() + (row * _width + x) * _channels;
+		for (size_t col = x; col < xEnd; ++col, pDst += _channels) {
+			memcpy(pDst, pColor, _channels);
+		}
+	}
+}
+
+void Image::resampleFrom(const Image& source, size_t x, size_t y, size_t width, size_t height, size_t padding, ImageFilter filter)
+{
+	if (source.isEmpty() || width == 0 || height == 0) {
+		return;
+	}
+
+	axisFilter_t filterX = _createAxisFilter(source._width, width, filter);
+	axisFilter_t filterY = _createAxisFilter(source._height, height, filter);
+
+	// padding repeats the border pixels of the region, clipped to the image
+	size_t x0 = x >= padding ? x - padding : 0;
+	size_t y0 = y >= padding ? y - padding : 0;
+	size_t x1 = std::min(x + width + padding, _width);
+	size_t y1 = std::min(y + height + padding, _height);
+
+	const size_t sourceChannels = source._channels;
+	const size_t rowLength = width * sourceChannels;
+
+	auto localRow = [y, height](size_t row) {
+		return std::min(size_t(std::max(int64_t(row) - int64_t(y), int64_t(0))), height - 1);
+	};
+
+	// separable filter: source rows are filtered horizontally into a float buffer, which is
+	// then filtered vertically. Bands of rows bound the buffer size, the inner loops run over
+	// contiguous floats and vectorize.
+	parallelFor(y0, y1, [&](size_t blockBegin, size_t blockEnd) {
+		std::vector<float> rows;
+		std::vector<float> pixels(rowLength);
+
+		for (size_t bandBegin = blockBegin; bandBegin < blockEnd; bandBegin += _resampleBandHeight) {
+			size_t bandEnd = std::min(bandBegin + _resampleBandHeight, blockEnd);
+			size_t localBegin = localRow(bandBegin);
+			size_t localEnd = localRow(bandEnd - 1) + 1;
+
+			// tap indices grow monotonically with the destination index
+			size_t sourceBegin = filterY.taps[filterY.offsets[localBegin]].index;
+			size_t sourceEnd = filterY.taps[filterY.offsets[localEnd] - 1].index + 1;
+
+			rows.assign((sourceEnd - sourceBegin) * rowLength, 0.0f);
+
+			for (size_t sourceRow = sourceBegin; sourceRow < sourceEnd; ++sourceRow) {
+				const uint8_t* pSrc = source.pixel(0, sourceRow);
+				float* pDst = rows.data() + (sourceRow - sourceBegin) * rowLength;
+
+				for (size_t i = 0; i < width; ++i, pDst += sourceChannels) {
+					for (size_t t = filterX.offsets[i]; t < filterX.offsets[i + 1]; ++t) {
+						const uint8_t* pPixel = pSrc + filterX.taps[t].index * sourceChannels;
+						float weight = filterX.taps[t].weight;
+						for (size_t c = 0; c < sourceChannels; ++c) {
+							pDst[c] += pPixel[c] * weight;
+						}
+					}
+				}
+			}
+
+			for (size_t row = bandBegin; row < bandEnd; ++row) {
+				size_t localY = localRow(row);
+				std::fill(pixels.begin(), pixels.end(), 0.0f);
+
+				for (size_t t = filterY.offsets[localY]; t < filterY.offsets[localY + 1]; ++t) {
+					const float* pRow = rows.data() + (filterY.taps[t].index - sourceBegin) * rowLength;
+					float weight = filterY.taps[t].weight;
+					for (size_t i = 0; i < rowLength; ++i) {
+						pixels[i] += pRow[i] * weight;
+					}
+				}
+
+				uint8_t* pDst = _pixels.data() + (row * _width + x0) * _channels;
+				for (size_t col = x0; col < x1; ++col, pDst += _channels) {
+					size_t localX = std::min(size_t(std::max(int64_t(col) - int64_t(x), int64_t(0))), width - 1);
+					float rgba[4];
+					_toRGBA(pixels.data() + localX * sourceChannels, sourceChannels, rgba);
+					_fromRGBA(rgba, _channels, pDst);
+				}
+			}
+		}
+	}, _resampleBandHeight);
+}
+
+Image Image::resized(size_t width, size_t height, ImageFilter filter) const
+{
+	Image image(width, height, _channels);
+	image.resampleFrom(*this, 0, 0, width, height, 0, filter);
+	return image;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Result Image::_loadPNG(const std::string& filePath)
+{
+#if defined(MESHSMITH_HAS_PNG)
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&image, filePath.c_str())) {
+		return Result::error("failed to read PNG file: " + filePath + ", reason: " + image.message);
+	}
+
+	// keep gray and alpha channels as stored, 16 bit and palette images are converted to 8 bit
+	bool hasColor = (image.format & PNG_FORMAT_FLAG_COLOR) != 0;
+	bool hasAlpha = (image.format & PNG_FORMAT_FLAG_ALPHA) != 0;
+	image.format = (hasColor ? PNG_FORMAT_FLAG_COLOR : 0) | (hasAlpha ? PNG_FORMAT_FLAG_ALPHA : 0);
+
+	_width = image.width;
+	_height = image.height;
+	_channels = PNG_IMAGE_PIXEL_CHANNELS(image.format);
+	_pixels.resize(PNG_IMAGE_SIZE(image));
+
+	if (!png_image_finish_read(&image, nullptr, _pixels.data(), 0, nullptr)) {
+		png_image_free(&image);
+		return Result::error("failed to read PNG file: " + filePath + ", reason: " + image.message);
+	}
+
+	return Result::ok();
+#else
+	return Result::error("PNG support not available in this build: " + filePath);
+#endif
+}
+
+Result Image::_encodePNG(std::vector<uint8_t>& data) const
+{
+#if defined(MESHSMITH_HAS_PNG)
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	image.width = png_uint_32(_width);
+	image.height = png_uint_32(_height);
+	image.format = (_channels >= 3 ? PNG_FORMAT_FLAG_COLOR : 0) | (_channels % 2 == 0 ? PNG_FORMAT_FLAG_ALPHA : 0);
+
+	// the first call computes the size of the encoded image
+	png_alloc_size_t size = 0;
+	if (!png_image_write_to_memory(&image, nullptr, &size, 0, _pixels.data(), 0, nullptr)) {
+		return Result::error(std::string("failed to encode PNG image, reason: ") + image.message);
+	}
+
+	data.resize(size);
+	if (!png_image_write_to_memory(&image, data.data(), &size, 0, _pixels.data(), 0, nullptr)) {
+		return Result::error(std::string("failed to encode PNG image, reason: ") + image.message);
+	}
+
+	data.resize(size);
+	return Result::ok();
+#else
+	return Result::error("PNG support not available in this build");
+#endif
+}
+
+Result Image::_loadJPEG(const std::string& filePath, bool headerOnly)
+{
+#if defined(MESHSMITH_HAS_JPEG)
+	FILE* pFile = fopen(filePath.c_str(), "rb");
+	if (!pFile) {
+		return Result::error("failed to open JPEG file: " + filePath);
+	}
+
+	jpeg_decompress_struct info;
+	jpegErrorManager_t error;
+	info.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = _jpegErrorExit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_decompress(&info);
+		fclose(pFile);
+		return Result::error("failed to read JPEG file: " + filePath + ", reason: " + error.message);
+	}
+
+	jpeg_create_decompress(&info);
+	jpeg_stdio_src(&info, pFile);
+	jpeg_read_header(&info, TRUE);
+
+	info.out_color_space = info.num_components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+
+	if (headerOnly) {
+		_width = info.image_width;
+		_height = info.image_height;
+		_channels = info.num_components == 1 ? 1 : 3;
+		jpeg_destroy_decompress(&info);
+		fclose(pFile);
+		return Result::ok();
+	}
+
+	jpeg_start_decompress(&info);
+
+	_width = info.output_width;
+	_height = info.output_height;
+	_channels = info.output_components;
+	_pixels.resize(_width * _height * _channels);
+
+	while (info.output_scanline < info.output_height) {
+		JSAMPROW pRow = _pixels.data() + info.output_scanline * _width * _channels;
+		jpeg_read_scanlines(&info, &pRow, 1);
+	}
+
+	jpeg_finish_decompress(&info);
+	jpeg_destroy_decompress(&info);
+	fclose(pFile);
+
+	return Result::ok();
+#else
+	return Result::error("JPEG support not available in this build: " + filePath);
+#endif
+}
+
+Result Image::_encodeJPEG(std::vector<uint8_t>& data, int quality) const
+{
+#if defined(MESHSMITH_HAS_JPEG)
+	// JPEG has no alpha, gray+alpha and RGBA images are written without it
+	std::vector<uint8_t> row(_width * 3);
+	int components = _channels <= 2 ? 1 : 3;
+
+	// the destination buffer is allocated by libjpeg
+	unsigned char* pBuffer = nullptr;
+	unsigned long size = 0;
+
+	jpeg_compress_struct info;
+	jpegErrorManager_t error;
+	info.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = _jpegErrorExit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_compress(&info);
+		free(pBuffer);
+		return Result::error(std::string("failed to encode JPEG image, reason: ") + error.message);
+	}
+
+	jpeg_create_compress(&info);
+	jpeg_mem_dest(&info, &pBuffer, &size);
+
+	info.image_width = JDIMENSION(_width);
+	info.image_height = JDIMENSION(_height);
+	info.input_components = components;
+	info.in_color_space = components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+
+	jpeg_set_defaults(&info);
+	jpeg_set_quality(&info, quality, TRUE);
+	jpeg_start_compress(&info, TRUE);
+
+	while (info.next_scanline < info.image_height) {
+		const uint8_t* pSrc = pixel(0, info.next_scanline);
+		for (size_t i = 0; i < _width; ++i, pSrc += _channels) {
+			memcpy(row.data() + i * components, pSrc, components);
+		}
+
+		JSAMPROW pRow = row.data();
+		jpeg_write_scanlines(&info, &pRow, 1);
+	}
+
+	jpeg_finish_compress(&info);
+	jpeg_destroy_compress(&info);
+
+	data.assign(pBuffer, pBuffer + size);
+	free(pBuffer);
+
+	return Result::ok();
+#else
+	return Result::error("JPEG support not available in this build");
+#endif
+}
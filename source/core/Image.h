@@ -0,0 +1,103 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_IMAGE_H
+#define _MESHSMITH_IMAGE_H
+
+#include "library.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace meshsmith
+{
+	/// Smooth filtering (box when downscaling, bilinear when upscaling), or nearest
+	/// neighbor for maps whose values must not be mixed, e.g. IDs.
+	enum class ImageFilter { Smooth, Nearest };
+
+	/// 8 bit image with 1 (gray), 2 (gray, alpha), 3 (RGB) or 4 (RGBA) interleaved channels.
+	/// PNG files are supported if built with libpng (MESHSMITH_HAS_PNG), JPEG files if
+	/// built with libjpeg (MESHSMITH_HAS_JPEG).
+	class MESHSMITH_CORE_EXPORT Image
+	{
+	public:
+		Image();
+		Image(size_t width, size_t height, size_t channels);
+
+		/// Returns true if files with the extension of the given path can be read and written.
+		static bool isSupported(const std::string& filePath);
+		/// Returns true if images can be encoded as WebP.
+		static bool isWebPSupported();
+		/// Reads the size and number of channels from the file header, without decoding the pixels.
+		static flow::Result readInfo(const std::string& filePath, size_t& width, size_t& height, size_t& channels);
+
+	public:
+		/// Reads a PNG or JPEG file, the format is determined by the file extension.
+		flow::Result load(const std::string& filePath);
+		/// Reads a PNG or JPEG file scaled down to fit within maxSize, keeping the aspect ratio.
+		/// The file is decoded and filtered in bands of rows, the full-size image is never held
+		/// in memory. JPEG files are partially reduced by the decoder. If maxSize is 0 or the
+		/// image fits, it is loaded as is. Each band is filtered by numThreads threads, pass 1
+		/// when several images are loaded in parallel.
+		flow::Result loadScaled(const std::string& filePath, size_t maxSize, ImageFilter filter = ImageFilter::Smooth,
+			size_t numThreads = 1);
+		/// Writes a PNG or JPEG file, the format is determined by the file extension.
+		flow::Result save(const std::string& filePath, int jpegQuality = 90) const;
+		/// Encodes the image in memory as PNG or JPEG, the format is determined by the extension
+		/// of the given file path, which isn't written.
+		flow::Result encode(const std::string& filePath, std::vector<uint8_t>& data, int jpegQuality = 90) const;
+		/// Encodes the image as WebP with the given quality (0 - 100), requires a build
+		/// with libwebp (MESHSMITH_HAS_WEBP).
+		flow::Result encodeWebP(float quality, bool lossless, std::vector<uint8_t>& webpData) const;
+
+		/// Sets all pixels of the given region to the given color, which has channels() components.
+		void fill(size_t x, size_t y, size_t width, size_t height, const uint8_t* pColor);
+		/// Resamples the source image into the given region of this image. Smooth filtering averages
+		/// the covered source pixels when downscaling and interpolates bilinearly when upscaling.
+		/// The region is surrounded by padding pixels repeating its border, so filtering doesn't
+		/// bleed into neighbors. Bands of rows are processed in parallel. Channels are converted as needed.
+		void resampleFrom(const Image& source, size_t x, size_t y, size_t width, size_t height,
+			size_t padding = 0, ImageFilter filter = ImageFilter::Smooth);
+		/// Returns a copy of this image scaled to the given size.
+		Image resized(size_t width, size_t height, ImageFilter filter = ImageFilter::Smooth) const;
+
+		bool isEmpty() const { return _pixels.empty(); }
+		size_t width() const { return _width; }
+		size_t height() const { return _height; }
+		size_t channels() const { return _channels; }
+
+		uint8_t* data() { return _pixels.data(); }
+		const uint8_t* data() const { return _pixels.data(); }
+		const uint8_t* pixel(size_t x, size_t y) const { return _pixels.data() + (y * _width + x) * _channels; }
+
+	private:
+		flow::Result _loadPNG(const std::string& filePath);
+		flow::Result _encodePNG(std::vector<uint8_t>& data) const;
+		flow::Result _loadJPEG(const std::string& filePath, bool headerOnly = false);
+		flow::Result _encodeJPEG(std::vector<uint8_t>& data, int quality) const;
+
+		size_t _width;
+		size_t _height;
+		size_t _channels;
+		std::vector<uint8_t> _pixels;
+	};
+}
+
+#endif // _MESHSMITH_IMAGE_H
@@ -0,0 +1,120 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "KtxEncoder.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <mutex>
+
+#if defined(MESHSMITH_HAS_BASISU)
+# include <encoder/basisu_comp.h>
+#endif
+
+using namespace meshsmith;
+using namespace flow;
+
+// ETC1S quality (1 - 255) and effort (0 - 5), the encoder defaults
+static const int _etc1sQualityLevel = 128;
+static const int _etc1sCompressionLevel = 2;
+
+
+bool KtxEncoder::isAvailable()
+{
+#if defined(MESHSMITH_HAS_BASISU)
+	return true;
+#else
+	return false;
+#endif
+}
+
+Result KtxEncoder::encode(const Image& image, TextureCompression compression,
+	TextureUsage usage, size_t numThreads, std::vector<uint8_t>& ktx2Data)
+{
+#if defined(MESHSMITH_HAS_BASISU)
+	static std::once_flag initFlag;
+	std::call_once(initFlag, []() { basisu::basisu_encoder_init(); });
+
+	// the encoder takes RGBA images
+	size_t width = image.width();
+	size_t height = image.height();
+	size_t channels = image.channels();
+
+	basisu::image sourceImage(uint32_t(width), uint32_t(height));
+	for (size_t y = 0; y < height; ++y) {
+		const uint8_t* pSrc = image.pixel(0, y);
+		for (size_t x = 0; x < width; ++x, pSrc += channels) {
+			uint8_t gray = pSrc[0];
+			uint8_t alpha = channels == 2 ? pSrc[1] : (channels == 4 ? pSrc[3] : 255);
+			if (channels >= 3) {
+				sourceImage(uint32_t(x), uint32_t(y)).set(pSrc[0], pSrc[1], pSrc[2], alpha);
+			}
+			else {
+				sourceImage(uint32_t(x), uint32_t(y)).set(gray, gray, gray, alpha);
+			}
+		}
+	}
+
+	bool isColor = usage == TextureUsage::Color;
+	bool useUASTC = compression == TextureCompression::UASTC || usage == TextureUsage::Normal;
+
+	basisu::job_pool jobPool(uint32_t(std::max(numThreads, size_t(1))));
+
+	basisu::basis_compressor_params params;
+	params.m_source_images.push_back(sourceImage);
+	params.m_read_source_images = false;
+	params.m_write_output_basis_files = false;
+	params.m_status_output = false;
+	params.m_pJob_pool = &jobPool;
+	params.m_multithreading = numThreads > 1;
+
+	params.m_perceptual = isColor;
+	params.m_mip_gen = true;
+	params.m_mip_srgb = isColor;
+	params.m_mip_renormalize = usage == TextureUsage::Normal;
+
+	if (useUASTC) {
+		params.m_uastc = true;
+		params.m_pack_uastc_flags = basisu::cPackUASTCLevelDefault;
+		params.m_ktx2_uastc_supercompression = basist::KTX2_SS_ZSTANDARD;
+	}
+	else {
+		params.m_quality_level = _etc1sQualityLevel;
+		params.m_compression_level = _etc1sCompressionLevel;
+	}
+
+	params.m_create_ktx2_file = true;
+	params.m_ktx2_srgb_transfer_func = isColor;
+
+	basisu::basis_compressor compressor;
+	if (!compressor.init(params)) {
+		return Result::error("failed to initialize KTX2 encoder");
+	}
+
+	basisu::basis_compressor::error_code errorCode = compressor.process();
+	if (errorCode != basisu::basis_compressor::cECSuccess) {
+		return Result::error("failed to encode KTX2 texture, error code: " + std::to_string(int(errorCode)));
+	}
+
+	const basisu::uint8_vec& output = compressor.get_output_ktx2_file();
+	ktx2Data.assign(output.begin(), output.end());
+
+	return Result::ok();
+#else
+	return Result::error("KTX2 texture compression not available in this build");
+#endif
+}
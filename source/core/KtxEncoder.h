@@ -0,0 +1,56 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_KTXENCODER_H
+#define _MESHSMITH_KTXENCODER_H
+
+#include "library.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace meshsmith
+{
+	class Image;
+
+	/// GPU texture compression of exported maps. ETC1S is small on disk and over the wire,
+	/// UASTC has higher quality. Both are transcoded by the viewer to a GPU block format.
+	enum class TextureCompression { None, ETC1S, UASTC };
+
+	/// Content of a map, determines color space and mipmap filtering. Data maps hold
+	/// values that must be kept exactly, e.g. zone IDs.
+	enum class TextureUsage { Color, Linear, Normal, Data };
+
+	/// Encodes images to KTX2 files with Basis Universal supercompression and a full
+	/// mipmap chain, for use with KHR_texture_basisu. Requires a build with the Basis
+	/// Universal encoder (MESHSMITH_HAS_BASISU).
+	class MESHSMITH_CORE_EXPORT KtxEncoder
+	{
+	public:
+		static bool isAvailable();
+
+		/// Encodes a decoded image, maps are decoded and scaled by the caller. Normal maps are
+		/// always encoded as UASTC, ETC1S endpoint clustering visibly distorts normals.
+		static flow::Result encode(const Image& image, TextureCompression compression,
+			TextureUsage usage, size_t numThreads, std::vector<uint8_t>& ktx2Data);
+	};
+}
+
+#endif // _MESHSMITH_KTXENCODER_H
@@ -0,0 +1,184 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+using namespace meshsmith;
+
+// smallest page size of the supported platforms, larger pages are touched more than once
+static const size_t _pageSize = 4096;
+
+
+MappedFile::MappedFile() :
+	_isOpen(false),
+	_pData(nullptr),
+	_size(0),
+#if defined(_WIN32)
+	_hFile(INVALID_HANDLE_VALUE),
+	_hMapping(nullptr)
+#else
+	_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::prefetch() const
+{
+	if (!_pData) {
+		return;
+	}
+
+#if !defined(_WIN32)
+	::madvise((void*)_pData, _size, MADV_WILLNEED);
+#endif
+
+	// touching one byte per page faults the page in
+	volatile char sum = 0;
+	for (size_t offset = 0; offset < _size; offset += _pageSize) {
+		sum += _pData[offset];
+	}
+	(void)sum;
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& filePath)
+{
+	close();
+
+	_hFile = ::CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (_hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(_hFile, &fileSize)) {
+		close();
+		return false;
+	}
+
+	_size = size_t(fileSize.QuadPart);
+	_isOpen = true;
+
+	// empty files can't be mapped
+	if (_size == 0) {
+		return true;
+	}
+
+	_hMapping = ::CreateFileMappingA(_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!_hMapping) {
+		close();
+		return false;
+	}
+
+	_pData = (const char*)::MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!_pData) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_pData) {
+		::UnmapViewOfFile(_pData);
+	}
+	if (_hMapping) {
+		::CloseHandle(_hMapping);
+	}
+	if (_hFile != INVALID_HANDLE_VALUE) {
+		::CloseHandle(_hFile);
+	}
+
+	_isOpen = false;
+	_pData = nullptr;
+	_size = 0;
+	_hMapping = nullptr;
+	_hFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filePath)
+{
+	close();
+
+	_fd = ::open(filePath.c_str(), O_RDONLY);
+	if (_fd < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (::fstat(_fd, &fileStat) != 0) {
+		close();
+		return false;
+	}
+
+	_size = size_t(fileStat.st_size);
+	_isOpen = true;
+
+	// empty files can't be mapped
+	if (_size == 0) {
+		return true;
+	}
+
+	void* pData = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (pData == MAP_FAILED) {
+		close();
+		return false;
+	}
+
+	::madvise(pData, _size, MADV_SEQUENTIAL);
+	_pData = (const char*)pData;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_pData) {
+		::munmap((void*)_pData, _size);
+	}
+	if (_fd >= 0) {
+		::close(_fd);
+	}
+
+	_isOpen = false;
+	_pData = nullptr;
+	_size = 0;
+	_fd = -1;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_MAPPEDFILE_H
+#define _MESHSMITH_MAPPEDFILE_H
+
+#include "library.h"
+
+#include <string>
+
+namespace meshsmith
+{
+	/// Read-only memory mapping of a file.
+	class MESHSMITH_CORE_EXPORT MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+
+	public:
+		/// Maps the file with the given path into memory. Returns false on failure.
+		bool open(const std::string& filePath);
+		/// Unmaps the file.
+		void close();
+		/// Reads all pages of the mapping into memory, so later accesses don't wait for I/O.
+		/// Blocks until the file has been read, call it from a background thread to read ahead.
+		void prefetch() const;
+
+		bool isOpen() const { return _isOpen; }
+		const char* data() const { return _pData; }
+		size_t size() const { return _size; }
+
+	private:
+		bool _isOpen;
+		const char* _pData;
+		size_t _size;
+
+#if defined(_WIN32)
+		void* _hFile;
+		void* _hMapping;
+#else
+		int _fd;
+#endif
+	};
+}
+
+#endif // _MESHSMITH_MAPPEDFILE_H
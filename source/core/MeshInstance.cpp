@@ -0,0 +1,64 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MeshInstance.h"
+
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+
+using namespace meshsmith;
+
+static void _collectInstances(const aiNode* pNode, const aiMatrix4x4& parentTransform, std::vector<MeshInstance>& instances)
+{
+	aiMatrix4x4 transform = parentTransform * pNode->mTransformation;
+
+	for (size_t i = 0; i < pNode->mNumMeshes; ++i) {
+		MeshInstance instance = { pNode->mMeshes[i], pNode->mName.C_Str(), transform, transform.IsIdentity() };
+		instances.push_back(instance);
+	}
+
+	for (size_t i = 0; i < pNode->mNumChildren; ++i) {
+		_collectInstances(pNode->mChildren[i], transform, instances);
+	}
+}
+
+std::vector<MeshInstance> MeshInstance::collect(const aiScene* pScene)
+{
+	std::vector<MeshInstance> instances;
+
+	if (pScene->mRootNode) {
+		_collectInstances(pScene->mRootNode, aiMatrix4x4(), instances);
+	}
+	else {
+		for (size_t i = 0; i < pScene->mNumMeshes; ++i) {
+			MeshInstance instance = { i, std::string(), aiMatrix4x4(), true };
+			instances.push_back(instance);
+		}
+	}
+
+	return instances;
+}
+
+aiVector3D MeshInstance::position(const aiMesh* pMesh, size_t index) const
+{
+	return isIdentity ? pMesh->mVertices[index] : transform * pMesh->mVertices[index];
+}
+
+aiMatrix3x3 MeshInstance::normalTransform() const
+{
+	return aiMatrix3x3(transform).Inverse().Transpose();
+}
@@ -0,0 +1,52 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_MESHINSTANCE_H
+#define _MESHSMITH_MESHINSTANCE_H
+
+#include "library.h"
+
+#include <assimp/matrix4x4.h>
+
+#include <string>
+#include <vector>
+
+struct aiScene;
+struct aiMesh;
+
+namespace meshsmith
+{
+	/// Mesh referenced by a scene node, with the accumulated transform of the node.
+	struct MESHSMITH_CORE_EXPORT MeshInstance
+	{
+		size_t meshIndex;
+		std::string nodeName;
+		aiMatrix4x4 transform;
+		bool isIdentity;
+
+		/// Returns all mesh instances of the scene in node order. Without a
+		/// node hierarchy, each mesh is returned once with identity transform.
+		static std::vector<MeshInstance> collect(const aiScene* pScene);
+
+		/// Returns the position of the given vertex in scene space.
+		aiVector3D position(const aiMesh* pMesh, size_t index) const;
+		/// Returns the transform to apply to normals, the inverse transpose of the node transform.
+		aiMatrix3x3 normalTransform() const;
+	};
+}
+
+#endif // _MESHSMITH_MESHINSTANCE_H
@@ -0,0 +1,426 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ObjExporter.h"
+#include "OutputFile.h"
+
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+#include <assimp/material.h>
+
+#include <iostream>
+#include <future>
+#include <cstdio>
+#include <cstring>
+
+#include "parallel.h"
+#include "path.h"
+
+using namespace meshsmith;
+using namespace flow;
+
+using std::string;
+using std::cout;
+using std::endl;
+
+// number of lines formatted by one task
+static const size_t _chunkLines = 16384;
+
+/// Writes text that reads back to the same float, independent of the C locale. Returns the end of the text.
+static char* _formatFloat(char* pDst, float value)
+{
+	char text[32];
+
+	// %g drops trailing zeros, 9 significant digits always round-trip
+	int length = snprintf(text, sizeof(text), "%.9g", double(value));
+
+	// the decimal separator of the current locale (e.g. a comma) is written as a point
+	char* p = pDst;
+	for (int i = 0; i < length; ++i) {
+		char c = text[i];
+		if ((c >= '0' && c <= '9') || c == '-' || c == '+' || (c >= 'a' && c <= 'z')) {
+			*p++ = c;
+		}
+		else if (p == pDst || p[-1] != '.') {
+			*p++ = '.';
+		}
+	}
+
+	return p;
+}
+
+static char* _formatIndex(char* pDst, size_t value)
+{
+	char text[24];
+	char* pEnd = text + sizeof(text);
+	char* p = pEnd;
+
+	do {
+		*--p = char('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	memcpy(pDst, p, pEnd - p);
+	return pDst + (pEnd - p);
+}
+
+static string _materialName(const aiScene* pScene, size_t materialIndex)
+{
+	aiString name;
+	if (materialIndex < pScene->mNumMaterials
+		&& pScene->mMaterials[materialIndex]->Get(AI_MATKEY_NAME, name) == aiReturn_SUCCESS
+		&& name.length > 0) {
+		return name.C_Str();
+	}
+
+	return "material" + std::to_string(materialIndex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ObjExporter::ObjExporter() :
+	_positionOffset(0),
+	_texCoordOffset(0),
+	_normalOffset(0)
+{
+}
+
+ObjExporter::~ObjExporter()
+{
+}
+
+void ObjExporter::setOptions(const ObjExporterOptions& options)
+{
+	_options = options;
+}
+
+Result ObjExporter::exportScene(const aiScene* pScene, const string& fileName)
+{
+	_positionOffset = 0;
+	_texCoordOffset = 0;
+	_normalOffset = 0;
+
+	Result precompressionResult = CompressedFile::checkAvailable(_options.precompression);
+	if (precompressionResult.isError()) {
+		return precompressionResult;
+	}
+
+	std::vector<MeshInstance> instances = MeshInstance::collect(pScene);
+
+	path filePath(fileName);
+	string baseName = filePath.filename();
+	baseName = baseName.substr(0, baseName.size() - filePath.extension().size() - 1);
+	string materialFileName = baseName + ".mtl";
+	string materialFilePath = path(filePath.parent_path() / materialFileName).str();
+
+	if (_options.verbose) {
+		cout << "Writing OBJ file: " << fileName << ", mesh instances: " << instances.size() << endl;
+	}
+
+	OutputFile file;
+	if (!file.open(fileName, _options.precompression)) {
+		return Result::error("failed to write OBJ file: " + fileName);
+	}
+
+	string header = "# File produced by MeshSmith\n\n";
+	if (_options.writeMaterials) {
+		header += "mtllib " + materialFileName + "\n\n";
+	}
+	file.append(header.data(), header.size());
+
+	for (const auto& instance : instances) {
+		Result result = _writeMesh(file, pScene, instance);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	if (!file.close()) {
+		return Result::error("failed to write OBJ file: " + fileName);
+	}
+
+	if (_options.writeMaterials) {
+		return _writeMaterials(pScene, materialFilePath);
+	}
+
+	return Result::ok();
+}
+
+Result ObjExporter::_writeMesh(OutputFile& file, const aiScene* pScene, const MeshInstance& instance)
+{
+	const aiMesh* pMesh = pScene->mMeshes[instance.meshIndex];
+	size_t numVertices = pMesh->mNumVertices;
+
+	bool hasColors = pMesh->HasVertexColors(0);
+	bool hasTexCoords = pMesh->HasTextureCoords(0);
+	bool hasNormals = pMesh->HasNormals();
+	bool hasTexCoordsW = hasTexCoords && pMesh->mNumUVComponents[0] == 3;
+
+	string name = pMesh->mName.length > 0 ? string(pMesh->mName.C_Str()) : instance.nodeName;
+	if (name.empty()) {
+		name = "mesh" + std::to_string(instance.meshIndex);
+	}
+
+	for (size_t i = 0; i < pMesh->mNumFaces; ++i) {
+		const aiFace& face = pMesh->mFaces[i];
+		for (size_t j = 0; j < face.mNumIndices; ++j) {
+			if (face.mIndices[j] >= numVertices) {
+				return Result::error("invalid vertex index in mesh: " + name);
+			}
+		}
+	}
+
+	string header = "\ng " + name + "\nusemtl " + _materialName(pScene, pMesh->mMaterialIndex) + "\n";
+	if (!file.write(header.data(), header.size())) {
+		return Result::error("failed to write OBJ file: " + file.filePath());
+	}
+
+	const aiMatrix3x3 normalTransform = instance.normalTransform();
+	const bool isIdentity = instance.isIdentity;
+
+	Result result = _writeLines(file, numVertices, [pMesh, hasColors, &instance](size_t i, string& text) {
+		char line[160] = "v ";
+		aiVector3D position = instance.position(pMesh, i);
+
+		char* p = line + 2;
+		p = _formatFloat(p, position.x);
+		*p++ = ' ';
+		p = _formatFloat(p, position.y);
+		*p++ = ' ';
+		p = _formatFloat(p, position.z);
+
+		if (hasColors) {
+			const aiColor4D& color = pMesh->mColors[0][i];
+			*p++ = ' ';
+			p = _formatFloat(p, color.r);
+			*p++ = ' ';
+			p = _formatFloat(p, color.g);
+			*p++ = ' ';
+			p = _formatFloat(p, color.b);
+		}
+
+		*p++ = '\n';
+		text.append(line, p - line);
+	});
+
+	if (!result.isError() && hasTexCoords) {
+		result = _writeLines(file, numVertices, [pMesh, hasTexCoordsW](size_t i, string& text) {
+			char line[96] = "vt ";
+			const aiVector3D& uv = pMesh->mTextureCoords[0][i];
+
+			char* p = line + 3;
+			p = _formatFloat(p, uv.x);
+			*p++ = ' ';
+			p = _formatFloat(p, uv.y);
+
+			if (hasTexCoordsW) {
+				*p++ = ' ';
+				p = _formatFloat(p, uv.z);
+			}
+
+			*p++ = '\n';
+			text.append(line, p - line);
+		});
+	}
+
+	if (!result.isError() && hasNormals) {
+		result = _writeLines(file, numVertices, [pMesh, &normalTransform, isIdentity](size_t i, string& text) {
+			char line[96] = "vn ";
+			aiVector3D normal = pMesh->mNormals[i];
+			if (!isIdentity) {
+				normal = normalTransform * normal;
+				normal.Normalize();
+			}
+
+			char* p = line + 3;
+			p = _formatFloat(p, normal.x);
+			*p++ = ' ';
+			p = _formatFloat(p, normal.y);
+			*p++ = ' ';
+			p = _formatFloat(p, normal.z);
+
+			*p++ = '\n';
+			text.append(line, p - line);
+		});
+	}
+
+	if (result.isError()) {
+		return result;
+	}
+
+	// OBJ indices are one-based and count all vertices of the preceding meshes
+	size_t positionBase = _positionOffset + 1;
+	size_t texCoordBase = _texCoordOffset + 1;
+	size_t normalBase = _normalOffset + 1;
+
+	result = _writeLines(file, pMesh->mNumFaces, [pMesh, hasTexCoords, hasNormals, positionBase, texCoordBase, normalBase](size_t i, string& text) {
+		const aiFace& face = pMesh->mFaces[i];
+		if (face.mNumIndices == 0) {
+			return;
+		}
+
+		// points and lines reference positions only
+		bool isPolygon = face.mNumIndices > 2;
+		text.append(face.mNumIndices == 1 ? "p" : (face.mNumIndices == 2 ? "l" : "f"));
+
+		char token[80];
+		for (size_t j = 0; j < face.mNumIndices; ++j) {
+			size_t index = face.mIndices[j];
+
+			char* p = token;
+			*p++ = ' ';
+			p = _formatIndex(p, positionBase + index);
+
+			if (isPolygon && (hasTexCoords || hasNormals)) {
+				*p++ = '/';
+				if (hasTexCoords) {
+					p = _formatIndex(p, texCoordBase + index);
+				}
+				if (hasNormals) {
+					*p++ = '/';
+					p = _formatIndex(p, normalBase + index);
+				}
+			}
+
+			text.append(token, p - token);
+		}
+
+		text.push_back('\n');
+	});
+
+	_positionOffset += numVertices;
+	_texCoordOffset += hasTexCoords ? numVertices : 0;
+	_normalOffset += hasNormals ? numVertices : 0;
+
+	return result;
+}
+
+Result ObjExporter::_writeLines(OutputFile& file, size_t lineCount, lineFormatter_t formatter)
+{
+	size_t numThreads = parallelThreadCount();
+	size_t batchLines = _chunkLines * numThreads;
+
+	// a batch is formatted in parallel chunks while the previous batch is written
+	std::vector<string> batches[2];
+	std::future<bool> writer;
+
+	for (size_t first = 0, batchIndex = 0; first < lineCount; first += batchLines, ++batchIndex) {
+		size_t last = std::min(first + batchLines, lineCount);
+		size_t numChunks = (last - first + _chunkLines - 1) / _chunkLines;
+
+		std::vector<string>& chunks = batches[batchIndex % 2];
+		chunks.resize(numChunks);
+
+		parallelFor(0, numChunks, [&chunks, &formatter, first, last](size_t chunkBegin, size_t chunkEnd) {
+			for (size_t c = chunkBegin; c < chunkEnd; ++c) {
+				string& text = chunks[c];
+				text.clear();
+
+				size_t lineEnd = std::min(first + (c + 1) * _chunkLines, last);
+				for (size_t i = first + c * _chunkLines; i < lineEnd; ++i) {
+					formatter(i, text);
+				}
+			}
+		}, 1);
+
+		if (writer.valid() && !writer.get()) {
+			return Result::error("failed to write OBJ file: " + file.filePath());
+		}
+
+		for (const auto& text : chunks) {
+			file.append(text.data(), text.size());
+		}
+
+		writer = std::async(std::launch::async, [&file]() { return file.flush(); });
+	}
+
+	if (writer.valid() && !writer.get()) {
+		return Result::error("failed to write OBJ file: " + file.filePath());
+	}
+
+	return Result::ok();
+}
+
+Result ObjExporter::_writeMaterials(const aiScene* pScene, const string& filePath)
+{
+	string text = "# File produced by MeshSmith\n";
+	char number[32];
+
+	auto appendColor = [&text, &number](const char* pKey, const aiColor3D& color) {
+		text += pKey;
+		for (float value : { color.r, color.g, color.b }) {
+			text += ' ';
+			text.append(number, _formatFloat(number, value) - number);
+		}
+		text += '\n';
+	};
+
+	for (size_t i = 0; i < pScene->mNumMaterials; ++i) {
+		const aiMaterial* pMaterial = pScene->mMaterials[i];
+		text += "\nnewmtl " + _materialName(pScene, i) + "\n";
+
+		aiColor3D color;
+		if (pMaterial->Get(AI_MATKEY_COLOR_AMBIENT, color) == aiReturn_SUCCESS) {
+			appendColor("Ka", color);
+		}
+		if (pMaterial->Get(AI_MATKEY_COLOR_DIFFUSE, color) == aiReturn_SUCCESS) {
+			appendColor("Kd", color);
+		}
+		if (pMaterial->Get(AI_MATKEY_COLOR_SPECULAR, color) == aiReturn_SUCCESS) {
+			appendColor("Ks", color);
+		}
+		if (pMaterial->Get(AI_MATKEY_COLOR_EMISSIVE, color) == aiReturn_SUCCESS) {
+			appendColor("Ke", color);
+		}
+
+		float value = 0.0f;
+		if (pMaterial->Get(AI_MATKEY_SHININESS, value) == aiReturn_SUCCESS) {
+			text += "Ns ";
+			text.append(number, _formatFloat(number, value) - number);
+			text += '\n';
+		}
+		if (pMaterial->Get(AI_MATKEY_OPACITY, value) == aiReturn_SUCCESS) {
+			text += "d ";
+			text.append(number, _formatFloat(number, value) - number);
+			text += '\n';
+		}
+
+		const std::pair<aiTextureType, const char*> maps[] = {
+			{ aiTextureType_AMBIENT, "map_Ka" },
+			{ aiTextureType_DIFFUSE, "map_Kd" },
+			{ aiTextureType_SPECULAR, "map_Ks" },
+			{ aiTextureType_EMISSIVE, "map_Ke" },
+			{ aiTextureType_OPACITY, "map_d" },
+			{ aiTextureType_HEIGHT, "map_bump" },
+			{ aiTextureType_NORMALS, "norm" }
+		};
+
+		for (const auto& map : maps) {
+			aiString texturePath;
+			if (pMaterial->GetTexture(map.first, 0, &texturePath) == aiReturn_SUCCESS) {
+				text += string(map.second) + " " + texturePath.C_Str() + "\n";
+			}
+		}
+	}
+
+	OutputFile file;
+	if (!file.open(filePath, _options.precompression) || !file.write(text.data(), text.size()) || !file.close()) {
+		return Result::error("failed to write material file: " + filePath);
+	}
+
+	return Result::ok();
+}
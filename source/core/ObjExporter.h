@@ -0,0 +1,86 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_OBJEXPORTER_H
+#define _MESHSMITH_OBJEXPORTER_H
+
+#include "library.h"
+#include "CompressedFile.h"
+#include "MeshInstance.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+struct aiScene;
+
+namespace meshsmith
+{
+	class OutputFile;
+
+	struct ObjExporterOptions
+	{
+		bool verbose;
+		/// Write a .mtl material library next to the .obj file.
+		bool writeMaterials;
+		/// Write gzip and/or brotli compressed copies of the output files.
+		Precompression precompression;
+
+		ObjExporterOptions() :
+			verbose(false),
+			writeMaterials(true),
+			precompression(Precompression::None) { }
+	};
+
+	/// Wavefront OBJ writer. Lines are formatted in parallel chunks with up to 9 significant
+	/// digits, which read back to the same float regardless of the locale, the chunks are
+	/// written in order.
+	/// The output matches the Assimp OBJ exporter: mesh instances are transformed by
+	/// their node transforms, each instance is written as a group with its material.
+	class MESHSMITH_CORE_EXPORT ObjExporter
+	{
+	public:
+		ObjExporter();
+		virtual ~ObjExporter();
+
+		/// Sets the export options to be used for subsequent calls to exportScene().
+		void setOptions(const ObjExporterOptions& options);
+
+		/// Exports the given Assimp scene to the file with the given name, using
+		/// the previously set export options.
+		flow::Result exportScene(const aiScene* pScene, const std::string& fileName);
+
+	protected:
+		/// Appends the text of line index to the given string.
+		typedef std::function<void(size_t index, std::string& text)> lineFormatter_t;
+
+		flow::Result _writeMesh(OutputFile& file, const aiScene* pScene, const MeshInstance& instance);
+		flow::Result _writeLines(OutputFile& file, size_t lineCount, lineFormatter_t formatter);
+		flow::Result _writeMaterials(const aiScene* pScene, const std::string& filePath);
+
+		ObjExporterOptions _options;
+
+		// index offsets of the next mesh, OBJ indices refer to all preceding vertices
+		size_t _positionOffset;
+		size_t _texCoordOffset;
+		size_t _normalOffset;
+	};
+}
+
+#endif // _MESHSMITH_OBJEXPORTER_H
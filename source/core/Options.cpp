@@ -17,11 +17,44 @@
 
 #include "Options.h"
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
 
 using namespace meshsmith;
 using namespace flow;
 using std::string;
 
+static const char* _encodingMethodNames[] = { "auto", "edgebreaker", "sequential" };
+
+static const char* _colorFormatNames[] = { "uint8", "uint16" };
+static const char* _normalEncodingNames[] = { "float", "oct8", "oct16" };
+static const char* _bufferGroupingNames[] = { "none", "mesh", "primitive" };
+
+static const char* _precompressionNames[] = { "none", "gzip", "brotli", "gzipBrotli" };
+static const char* _textureCompressionNames[] = { "none", "etc1s", "uastc" };
+
+static const char* _attributeSourceNames[] = { "texCoords", "colors", "file" };
+
+static const char* _mapSizeNames[] = { "diffuse", "occlusion", "emissive", "metallicRoughness", "zone", "normal" };
+
+static const char* _predictionSchemeNames[] = {
+	"auto", "none", "difference", "parallelogram", "multiParallelogram", "texCoordsPortable", "geometricNormal"
+};
+
+template<typename T, size_t N>
+static T _enumFromName(const char* (&names)[N], const json& value, const string& option)
+{
+	string name = value.get<string>();
+	for (size_t i = 0; i < N; ++i) {
+		if (name == names[i]) {
+			return T(i);
+		}
+	}
+
+	throw std::invalid_argument("invalid value for option " + option + ": " + name);
+}
+
 Options::Options() :
 	verbose(false),
 	report(false),
@@ -29,20 +62,49 @@ Options::Options() :
 	joinVertices(false),
 	stripNormals(false),
 	stripTexCoords(false),
+	keepColors(false),
 	scale(1.0f),
 	translate(0.0f, 0.0f, 0.0f),
 	alignX(Align::None),
 	alignY(Align::None),
 	alignZ(Align::None),
 	flipUV(false),
+	precompression(Precompression::None),
 	useCompression(false),
 	objectSpaceNormals(false),
 	embedMaps(false),
+	interleaved(false),
+	splitMeshes(false),
+	colorFormat(VertexColorFormat::UInt8),
+	normalEncoding(NormalEncoding::Float),
+	octNormalsOnly(false),
+	maxBufferSize(0),
+	bufferGrouping(BufferGrouping::None),
+	progressiveLayout(false),
+	atlasMaps(false),
+	atlasMaxSize(8192),
+	packORM(false),
+	textureCompression(TextureCompression::None),
+	webpMaps(false),
+	webpQuality(80.0f),
+	webpFallback(false),
+	maxMapPixels(8192 * 8192),
+	mapMipmaps(false),
 	compressionLevel(7),
 	positionQuantizationBits(14),
 	texCoordsQuantizationBits(12),
 	normalsQuantizationBits(10),
-	genericQuantizationBits(8)
+	genericQuantizationBits(8),
+	maxError(0.0f),
+	maxRelativeError(0.0f),
+	maxNormalError(0.5f),
+	maxTexCoordError(0.00025f),
+	maxGenericError(0.002f),
+	encodingMethod(DracoEncodingMethod::Auto),
+	sequentialFaceThreshold(1000000),
+	positionPrediction(DracoPredictionScheme::Auto),
+	normalsPrediction(DracoPredictionScheme::Auto),
+	texCoordsPrediction(DracoPredictionScheme::Auto)
 {
 	matrix.setIdentity();
 }
@@ -59,9 +121,11 @@ Result Options::fromJSON(const flow::json& opts)
 		joinVertices = opts.count("joinVertices") ? opts.at("joinVertices").get<bool>() : false;
 		stripNormals = opts.count("stripNormals") ? opts.at("stripNormals").get<bool>() : false;
 		stripTexCoords = opts.count("stripTexCoords") ? opts.at("stripTexCoords").get<bool>() : false;
+		keepColors = opts.count("keepColors") ? opts.at("keepColors").get<bool>() : false;
 		swizzle = opts.count("swizzle") ? opts.at("swizzle").get<string>() : string{};
 		scale = opts.count("scale") ? opts.at("scale").get<float>() : 1.0f;
 		flipUV = opts.count("flipUV") ? opts.at("flipUV").get<bool>() : false;
+		precompression = opts.count("precompress") ? _enumFromName<Precompression>(_precompressionNames, opts.at("precompress"), "precompress") : Precompression::None;
 
 		if (opts.count("translate")) {
 			auto t = opts.at("translate");
@@ -115,6 +179,48 @@ Result Options::fromJSON(const flow::json& opts)
 			normalMap = gltfx.count("normalMap") ? gltfx.at("normalMap").get<string>() : string{};
 			objectSpaceNormals = gltfx.count("objectSpaceNormals") ? gltfx.at("objectSpaceNormals").get<bool>() : false;
 			embedMaps = gltfx.count("embedMaps") ? gltfx.at("embedMaps").get<bool>() : false;
+			interleaved = gltfx.count("interleaved") ? gltfx.at("interleaved").get<bool>() : false;
+			splitMeshes = gltfx.count("splitMeshes") ? gltfx.at("splitMeshes").get<bool>() : false;
+			maxBufferSize = gltfx.count("maxBufferSize") ? gltfx.at("maxBufferSize").get<uint64_t>() : 0;
+			bufferGrouping = gltfx.count("bufferGrouping") ? _enumFromName<BufferGrouping>(_bufferGroupingNames, gltfx.at("bufferGrouping"), "bufferGrouping") : BufferGrouping::None;
+			progressiveLayout = gltfx.count("progressiveLayout") ? gltfx.at("progressiveLayout").get<bool>() : false;
+			atlasMaps = gltfx.count("atlasMaps") ? gltfx.at("atlasMaps").get<bool>() : false;
+			atlasMaxSize = gltfx.count("atlasMaxSize") ? gltfx.at("atlasMaxSize").get<uint32_t>() : 8192;
+			packORM = gltfx.count("packORM") ? gltfx.at("packORM").get<bool>() : false;
+			textureCompression = gltfx.count("textureCompression") ? _enumFromName<TextureCompression>(_textureCompressionNames, gltfx.at("textureCompression"), "textureCompression") : TextureCompression::None;
+			webpMaps = gltfx.count("webpMaps") ? gltfx.at("webpMaps").get<bool>() : false;
+			webpQuality = gltfx.count("webpQuality") ? gltfx.at("webpQuality").get<float>() : 80.0f;
+			webpFallback = gltfx.count("webpFallback") ? gltfx.at("webpFallback").get<bool>() : false;
+			maxMapPixels = gltfx.count("maxMapPixels") ? gltfx.at("maxMapPixels").get<uint64_t>() : 8192 * 8192;
+			mapMipmaps = gltfx.count("mapMipmaps") ? gltfx.at("mapMipmaps").get<bool>() : false;
+			hashCache = gltfx.count("hashCache") ? gltfx.at("hashCache").get<string>() : string{};
+
+			mapSizes.clear();
+			if (gltfx.count("mapSizes")) {
+				const json& sizes = gltfx.at("mapSizes");
+				for (auto it = sizes.begin(); it != sizes.end(); ++it) {
+					if (std::find(std::begin(_mapSizeNames), std::end(_mapSizeNames), it.key()) == std::end(_mapSizeNames)) {
+						throw std::invalid_argument("invalid map name for option mapSizes: " + it.key());
+					}
+					mapSizes[it.key()] = it.value().get<uint32_t>();
+				}
+			}
+			colorFormat = gltfx.count("colorFormat") ? _enumFromName<VertexColorFormat>(_colorFormatNames, gltfx.at("colorFormat"), "colorFormat") : VertexColorFormat::UInt8;
+			normalEncoding = gltfx.count("normalEncoding") ? _enumFromName<NormalEncoding>(_normalEncodingNames, gltfx.at("normalEncoding"), "normalEncoding") : NormalEncoding::Float;
+			octNormalsOnly = gltfx.count("octNormalsOnly") ? gltfx.at("octNormalsOnly").get<bool>() : false;
+
+			customAttributes.clear();
+			if (gltfx.count("customAttributes")) {
+				for (const auto& attr : gltfx.at("customAttributes")) {
+					GLTFCustomAttribute attrib;
+					attrib.name = attr.at("name").get<string>();
+					attrib.source = attr.count("source") ? _enumFromName<CustomAttributeSource>(_attributeSourceNames, attr.at("source"), "source") : CustomAttributeSource::TexCoords;
+					attrib.channel = attr.count("channel") ? attr.at("channel").get<uint32_t>() : 0;
+					attrib.numComponents = attr.count("components") ? attr.at("components").get<uint32_t>() : 1;
+					attrib.file = attr.count("file") ? attr.at("file").get<string>() : string{};
+					customAttributes.push_back(attrib);
+				}
+			}
 			useCompression = gltfx.count("useCompression") ? gltfx.at("useCompression").get<bool>() : false;
 		}
 
@@ -125,6 +231,16 @@ Result Options::fromJSON(const flow::json& opts)
 			texCoordsQuantizationBits = cmp.count("texCoordsQuantizationBits") ? cmp.at("texCoordsQuantizationBits").get<uint32_t>() : 12;
 			normalsQuantizationBits = cmp.count("normalsQuantizationBits") ? cmp.at("normalsQuantizationBits").get<uint32_t>() : 10;
 			genericQuantizationBits = cmp.count("genericQuantizationBits") ? cmp.at("genericQuantizationBits").get<uint32_t>() : 8;
+			maxError = cmp.count("maxError") ? cmp.at("maxError").get<float>() : 0.0f;
+			maxRelativeError = cmp.count("maxRelativeError") ? cmp.at("maxRelativeError").get<float>() : 0.0f;
+			maxNormalError = cmp.count("maxNormalError") ? cmp.at("maxNormalError").get<float>() : 0.5f;
+			maxTexCoordError = cmp.count("maxTexCoordError") ? cmp.at("maxTexCoordError").get<float>() : 0.00025f;
+			maxGenericError = cmp.count("maxGenericError") ? cmp.at("maxGenericError").get<float>() : 0.002f;
+			encodingMethod = cmp.count("encodingMethod") ? _enumFromName<DracoEncodingMethod>(_encodingMethodNames, cmp.at("encodingMethod"), "encodingMethod") : DracoEncodingMethod::Auto;
+			sequentialFaceThreshold = cmp.count("sequentialFaceThreshold") ? cmp.at("sequentialFaceThreshold").get<uint32_t>() : 1000000;
+			positionPrediction = cmp.count("positionPrediction") ? _enumFromName<DracoPredictionScheme>(_predictionSchemeNames, cmp.at("positionPrediction"), "positionPrediction") : DracoPredictionScheme::Auto;
+			normalsPrediction = cmp.count("normalsPrediction") ? _enumFromName<DracoPredictionScheme>(_predictionSchemeNames, cmp.at("normalsPrediction"), "normalsPrediction") : DracoPredictionScheme::Auto;
+			texCoordsPrediction = cmp.count("texCoordsPrediction") ? _enumFromName<DracoPredictionScheme>(_predictionSchemeNames, cmp.at("texCoordsPrediction"), "texCoordsPrediction") : DracoPredictionScheme::Auto;
 		}
 	}
 	catch (const std::exception& e) {
@@ -164,6 +280,9 @@ json Options::toJSON() const
 	if (stripTexCoords) {
 		result["stripTexCoords"] = stripTexCoords;
 	}
+	if (keepColors) {
+		result["keepColors"] = keepColors;
+	}
 	if (!swizzle.empty()) {
 		result["swizzle"] = swizzle;
 	}
@@ -176,6 +295,9 @@ json Options::toJSON() const
 	if (!matrix.isIdentity()) {
 		result["matrix"] = matrix.toJSON(Matrix4f::ColumnMajor);
 	}
+	if (precompression != Precompression::None) {
+		result["precompress"] = _precompressionNames[size_t(precompression)];
+	}
 
 	json gltfx;
 	if (useCompression) {
@@ -196,6 +318,81 @@ json Options::toJSON() const
 	if (embedMaps) {
 		gltfx["embedMaps"] = true;
 	}
+	if (interleaved) {
+		gltfx["interleaved"] = true;
+	}
+	if (splitMeshes) {
+		gltfx["splitMeshes"] = true;
+	}
+	if (maxBufferSize > 0) {
+		gltfx["maxBufferSize"] = maxBufferSize;
+	}
+	if (bufferGrouping != BufferGrouping::None) {
+		gltfx["bufferGrouping"] = _bufferGroupingNames[size_t(bufferGrouping)];
+	}
+	if (progressiveLayout) {
+		gltfx["progressiveLayout"] = true;
+	}
+	if (atlasMaps) {
+		gltfx["atlasMaps"] = true;
+	}
+	if (atlasMaxSize != 8192) {
+		gltfx["atlasMaxSize"] = atlasMaxSize;
+	}
+	if (packORM) {
+		gltfx["packORM"] = true;
+	}
+	if (textureCompression != TextureCompression::None) {
+		gltfx["textureCompression"] = _textureCompressionNames[size_t(textureCompression)];
+	}
+	if (webpMaps) {
+		gltfx["webpMaps"] = true;
+	}
+	if (webpQuality != 80.0f) {
+		gltfx["webpQuality"] = webpQuality;
+	}
+	if (webpFallback) {
+		gltfx["webpFallback"] = true;
+	}
+	if (!mapSizes.empty()) {
+		gltfx["mapSizes"] = mapSizes;
+	}
+	if (maxMapPixels != 8192 * 8192) {
+		gltfx["maxMapPixels"] = maxMapPixels;
+	}
+	if (mapMipmaps) {
+		gltfx["mapMipmaps"] = true;
+	}
+	if (!hashCache.empty()) {
+		gltfx["hashCache"] = hashCache;
+	}
+	if (colorFormat != VertexColorFormat::UInt8) {
+		gltfx["colorFormat"] = _colorFormatNames[size_t(colorFormat)];
+	}
+	if (normalEncoding != NormalEncoding::Float) {
+		gltfx["normalEncoding"] = _normalEncodingNames[size_t(normalEncoding)];
+	}
+	if (octNormalsOnly) {
+		gltfx["octNormalsOnly"] = octNormalsOnly;
+	}
+	if (!customAttributes.empty()) {
+		json attributes = json::array();
+		for (const auto& attrib : customAttributes) {
+			json attr = {
+				{ "name", attrib.name },
+				{ "source", _attributeSourceNames[size_t(attrib.source)] },
+				{ "components", attrib.numComponents }
+			};
+			if (attrib.source == CustomAttributeSource::File) {
+				attr["file"] = attrib.file;
+			}
+			else {
+				attr["channel"] = attrib.channel;
+			}
+			attributes.push_back(attr);
+		}
+		gltfx["customAttributes"] = attributes;
+	}
 
 	if (!gltfx.empty()) {
 		result["gltfx"] = gltfx;
@@ -218,6 +415,36 @@ json Options::toJSON() const
 		if (genericQuantizationBits > 0) {
 			compression["genericQuantizationBits"] = genericQuantizationBits;
 		}
+		if (maxError > 0.0f) {
+			compression["maxError"] = maxError;
+		}
+		if (maxRelativeError > 0.0f) {
+			compression["maxRelativeError"] = maxRelativeError;
+		}
+		if (maxNormalError != 0.5f) {
+			compression["maxNormalError"] = maxNormalError;
+		}
+		if (maxTexCoordError != 0.00025f) {
+			compression["maxTexCoordError"] = maxTexCoordError;
+		}
+		if (maxGenericError != 0.002f) {
+			compression["maxGenericError"] = maxGenericError;
+		}
+		if (encodingMethod != DracoEncodingMethod::Auto) {
+			compression["encodingMethod"] = _encodingMethodNames[size_t(encodingMethod)];
+		}
+		if (sequentialFaceThreshold != 1000000) {
+			compression["sequentialFaceThreshold"] = sequentialFaceThreshold;
+		}
+		if (positionPrediction != DracoPredictionScheme::Auto) {
+			compression["positionPrediction"] = _predictionSchemeNames[size_t(positionPrediction)];
+		}
+		if (normalsPrediction != DracoPredictionScheme::Auto) {
+			compression["normalsPrediction"] = _predictionSchemeNames[size_t(normalsPrediction)];
+		}
+		if (texCoordsPrediction != DracoPredictionScheme::Auto) {
+			compression["texCoordsPrediction"] = _predictionSchemeNames[size_t(texCoordsPrediction)];
+		}
 
 		result["compression"] = compression;
 	}
@@ -20,6 +20,7 @@
 
 #include "library.h"
 #include "Processor.h"
+#include "GLTFExporter.h"
 
 #include "math/Vector3T.h"
 #include "math/Matrix4T.h"
@@ -27,6 +28,8 @@
 #include "core/json.h"
 
 #include <string>
+#include <vector>
+#include <map>
 
 namespace meshsmith
 {
@@ -46,6 +49,7 @@ namespace meshsmith
 		bool joinVertices;
 		bool stripNormals;
 		bool stripTexCoords;
+		bool keepColors;
 		std::string swizzle;
 		float scale;
 		flow::Vector3f translate;
@@ -53,6 +57,7 @@ namespace meshsmith
 		Align alignY;
 		Align alignZ;
 		bool flipUV;
+		Precompression precompression;
 
 		flow::Matrix4f matrix;
 
@@ -66,6 +71,26 @@ namespace meshsmith
 		std::string normalMap;
 		bool objectSpaceNormals;
 		bool embedMaps;
+		bool interleaved;
+		bool splitMeshes;
+		VertexColorFormat colorFormat;
+		NormalEncoding normalEncoding;
+		bool octNormalsOnly;
+		uint64_t maxBufferSize;
+		BufferGrouping bufferGrouping;
+		bool progressiveLayout;
+		bool atlasMaps;
+		uint32_t atlasMaxSize;
+		bool packORM;
+		TextureCompression textureCompression;
+		bool webpMaps;
+		float webpQuality;
+		bool webpFallback;
+		std::map<std::string, uint32_t> mapSizes;
+		uint64_t maxMapPixels;
+		bool mapMipmaps;
+		std::string hashCache;
+		std::vector<GLTFCustomAttribute> customAttributes;
 
 		bool useCompression;
 		uint32_t compressionLevel;
@@ -73,6 +98,16 @@ namespace meshsmith
 		uint32_t texCoordsQuantizationBits;
 		uint32_t normalsQuantizationBits;
 		uint32_t genericQuantizationBits;
+		float maxError;
+		float maxRelativeError;
+		float maxNormalError;
+		float maxTexCoordError;
+		float maxGenericError;
+		DracoEncodingMethod encodingMethod;
+		uint32_t sequentialFaceThreshold;
+		DracoPredictionScheme positionPrediction;
+		DracoPredictionScheme normalsPrediction;
+		DracoPredictionScheme texCoordsPrediction;
 	};
 }
 
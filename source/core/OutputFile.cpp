@@ -0,0 +1,287 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OutputFile.h"
+#include "CompressedFile.h"
+
+#include <algorithm>
+
+#if !defined(_WIN32)
+# include <cerrno>
+# include <climits>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/uio.h>
+#endif
+
+using namespace meshsmith;
+
+// maximum number of blocks queued before they are written
+static const size_t _maxQueuedBlocks = 64;
+
+static const char _zeroBytes[4096] = { 0 };
+
+
+OutputFile::OutputFile() :
+	_byteLength(0),
+	_failed(false),
+#if defined(_WIN32)
+	_pFile(nullptr)
+#else
+	_fd(-1)
+#endif
+{
+}
+
+OutputFile::~OutputFile()
+{
+	close();
+}
+
+void OutputFile::append(const void* pData, size_t byteLength)
+{
+	if (byteLength == 0) {
+		return;
+	}
+
+	if (_queue.size() >= _maxQueuedBlocks) {
+		flush();
+	}
+
+	_queue.push_back(block_t((const char*)pData, byteLength));
+	_byteLength += byteLength;
+}
+
+void OutputFile::appendPadding(size_t byteLength)
+{
+	while (byteLength > 0) {
+		size_t size = std::min(byteLength, sizeof(_zeroBytes));
+		append(_zeroBytes, size);
+		byteLength -= size;
+	}
+}
+
+bool OutputFile::write(const void* pData, size_t byteLength)
+{
+	append(pData, byteLength);
+	return flush();
+}
+
+bool OutputFile::open(const std::string& filePath, Precompression precompression)
+{
+	if (!open(filePath)) {
+		return false;
+	}
+
+	for (auto format : precompressionFormats(precompression)) {
+		if (!addCompressedCopy(format)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool OutputFile::addCompressedCopy(CompressionFormat format)
+{
+	if (!isOpen() || _byteLength > 0) {
+		return false;
+	}
+
+	std::unique_ptr<CompressedFile> pCopy(new CompressedFile());
+	if (!pCopy->open(_filePath + CompressedFile::fileExtension(format), format)) {
+		return false;
+	}
+
+	_compressedCopies.push_back(std::move(pCopy));
+	return true;
+}
+
+void OutputFile::_compressQueue()
+{
+	// compressed copies receive the data as it is written, no need to read the file again
+	for (auto& pCopy : _compressedCopies) {
+		for (const auto& block : _queue) {
+			pCopy->write(block.first, block.second);
+		}
+	}
+}
+
+#if defined(_WIN32)
+
+bool OutputFile::open(const std::string& filePath)
+{
+	close();
+
+	_filePath = filePath;
+	_byteLength = 0;
+	_failed = false;
+
+	_pFile = fopen(filePath.c_str(), "wb");
+	if (!_pFile) {
+		return false;
+	}
+
+	// blocks are written as a whole, no need for stdio buffering
+	setvbuf(_pFile, nullptr, _IONBF, 0);
+	return true;
+}
+
+bool OutputFile::close()
+{
+	if (!_pFile) {
+		return !_failed;
+	}
+
+	flush();
+
+	if (fclose(_pFile) != 0) {
+		_failed = true;
+	}
+
+	for (auto& pCopy : _compressedCopies) {
+		if (!pCopy->close()) {
+			_failed = true;
+		}
+	}
+	_compressedCopies.clear();
+
+	_pFile = nullptr;
+	return !_failed;
+}
+
+bool OutputFile::flush()
+{
+	if (!_pFile) {
+		_queue.clear();
+		return false;
+	}
+
+	_compressQueue();
+
+	for (const auto& block : _queue) {
+		if (!_failed && fwrite(block.first, 1, block.second, _pFile) != block.second) {
+			_failed = true;
+		}
+	}
+
+	_queue.clear();
+	return !_failed;
+}
+
+bool OutputFile::isOpen() const
+{
+	return _pFile != nullptr;
+}
+
+#else
+
+bool OutputFile::open(const std::string& filePath)
+{
+	close();
+
+	_filePath = filePath;
+	_byteLength = 0;
+	_failed = false;
+
+	_fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	return _fd >= 0;
+}
+
+bool OutputFile::close()
+{
+	if (_fd < 0) {
+		return !_failed;
+	}
+
+	flush();
+
+	if (::close(_fd) != 0) {
+		_failed = true;
+	}
+
+	for (auto& pCopy : _compressedCopies) {
+		if (!pCopy->close()) {
+			_failed = true;
+		}
+	}
+	_compressedCopies.clear();
+
+	_fd = -1;
+	return !_failed;
+}
+
+bool OutputFile::flush()
+{
+	if (_fd < 0 || _failed) {
+		_queue.clear();
+		return false;
+	}
+
+	_compressQueue();
+
+#if defined(IOV_MAX)
+	const size_t maxVectors = std::min(size_t(IOV_MAX), _maxQueuedBlocks);
+#else
+	const size_t maxVectors = std::min(size_t(16), _maxQueuedBlocks);
+#endif
+
+	iovec vectors[_maxQueuedBlocks];
+	size_t index = 0;
+
+	while (index < _queue.size()) {
+		size_t count = std::min(maxVectors, _queue.size() - index);
+		for (size_t i = 0; i < count; ++i) {
+			vectors[i].iov_base = (void*)_queue[index + i].first;
+			vectors[i].iov_len = _queue[index + i].second;
+		}
+
+		ssize_t written = ::writev(_fd, vectors, int(count));
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			_failed = true;
+			break;
+		}
+
+		// advance past the written blocks, partial writes resume within a block
+		size_t remaining = size_t(written);
+		while (remaining > 0) {
+			block_t& block = _queue[index];
+			if (remaining >= block.second) {
+				remaining -= block.second;
+				index++;
+			}
+			else {
+				block.first += remaining;
+				block.second -= remaining;
+				remaining = 0;
+			}
+		}
+	}
+
+	_queue.clear();
+	return !_failed;
+}
+
+bool OutputFile::isOpen() const
+{
+	return _fd >= 0;
+}
+
+#endif
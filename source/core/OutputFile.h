@@ -0,0 +1,92 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_OUTPUTFILE_H
+#define _MESHSMITH_OUTPUTFILE_H
+
+#include "library.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+
+namespace meshsmith
+{
+	class CompressedFile;
+	enum class CompressionFormat;
+	enum class Precompression;
+
+	/// Unbuffered output file. Data blocks are queued and written with a single
+	/// gathered write (writev) where available, so large blocks are written
+	/// straight from their source memory without intermediate copies.
+	class MESHSMITH_CORE_EXPORT OutputFile
+	{
+	public:
+		OutputFile();
+		~OutputFile();
+
+		OutputFile(const OutputFile& other) = delete;
+		OutputFile& operator=(const OutputFile& other) = delete;
+
+	public:
+		/// Creates or truncates the file with the given path. Returns false on failure.
+		bool open(const std::string& filePath);
+		/// Flushes queued data and closes the file. Returns false if any write failed.
+		bool close();
+		/// Creates or truncates the file and adds the compressed copies of the given
+		/// precompression setting. Returns false on failure.
+		bool open(const std::string& filePath, Precompression precompression);
+		/// Writes a compressed copy of all data to the file path plus .gz or .br.
+		/// Must be called after open() and before any data is written.
+		bool addCompressedCopy(CompressionFormat format);
+
+		/// Queues a block of data. The memory must stay valid until the next call to flush().
+		void append(const void* pData, size_t byteLength);
+		/// Queues the given number of zero bytes.
+		void appendPadding(size_t byteLength);
+		/// Writes all queued blocks to the file.
+		bool flush();
+
+		/// Writes the given block immediately.
+		bool write(const void* pData, size_t byteLength);
+
+		bool isOpen() const;
+		/// Total number of bytes written and queued.
+		size_t byteLength() const { return _byteLength; }
+		const std::string& filePath() const { return _filePath; }
+
+	private:
+		typedef std::pair<const char*, size_t> block_t;
+
+		void _compressQueue();
+
+		std::string _filePath;
+		std::vector<block_t> _queue;
+		size_t _byteLength;
+		bool _failed;
+		std::vector<std::unique_ptr<CompressedFile>> _compressedCopies;
+
+#if defined(_WIN32)
+		FILE* _pFile;
+#else
+		int _fd;
+#endif
+	};
+}
+
+#endif // _MESHSMITH_OUTPUTFILE_H
@@ -0,0 +1,276 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PlyExporter.h"
+#include "OutputFile.h"
+#include "BinaryBuffer.h"
+
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <cstring>
+
+using namespace meshsmith;
+using namespace flow;
+
+using std::string;
+using std::cout;
+using std::endl;
+
+// size of the staging memory for faces of mixed polygon sizes
+static const size_t _faceBlockSize = 4 * 1024 * 1024;
+
+static uint8_t _colorToByte(float value)
+{
+	return uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+
+PlyExporter::PlyExporter()
+{
+}
+
+PlyExporter::~PlyExporter()
+{
+}
+
+void PlyExporter::setOptions(const PlyExporterOptions& options)
+{
+	_options = options;
+}
+
+Result PlyExporter::exportScene(const aiScene* pScene, const string& fileName)
+{
+	Result precompressionResult = CompressedFile::checkAvailable(_options.precompression);
+	if (precompressionResult.isError()) {
+		return precompressionResult;
+	}
+
+	std::vector<MeshInstance> instances = MeshInstance::collect(pScene);
+
+	// attributes present in any mesh are written for all vertices, zero where missing
+	vertexLayout_t layout = { false, false, false, 0 };
+	size_t numVertices = 0;
+	size_t numFaces = 0;
+
+	for (const auto& instance : instances) {
+		const aiMesh* pMesh = pScene->mMeshes[instance.meshIndex];
+		layout.hasNormals = layout.hasNormals || pMesh->HasNormals();
+		layout.hasTexCoords = layout.hasTexCoords || pMesh->HasTextureCoords(0);
+		layout.hasColors = layout.hasColors || pMesh->HasVertexColors(0);
+
+		for (size_t i = 0; i < pMesh->mNumFaces; ++i) {
+			const aiFace& face = pMesh->mFaces[i];
+			if (face.mNumIndices < 3) {
+				continue;
+			}
+			if (face.mNumIndices > std::numeric_limits<uint8_t>::max()) {
+				return Result::error("polygon with more than 255 vertices can't be written to PLY");
+			}
+			for (size_t j = 0; j < face.mNumIndices; ++j) {
+				if (face.mIndices[j] >= pMesh->mNumVertices) {
+					return Result::error(string("invalid vertex index in mesh: ") + pMesh->mName.C_Str());
+				}
+			}
+			numFaces++;
+		}
+
+		numVertices += pMesh->mNumVertices;
+	}
+
+	if (numVertices > size_t(std::numeric_limits<int32_t>::max())) {
+		return Result::error("too many vertices for PLY int indices: " + std::to_string(numVertices));
+	}
+
+	layout.byteSize = 3 * sizeof(float)
+		+ (layout.hasNormals ? 3 * sizeof(float) : 0)
+		+ (layout.hasTexCoords ? 2 * sizeof(float) : 0)
+		+ (layout.hasColors ? 4 : 0);
+
+	string header = "ply\nformat binary_little_endian 1.0\ncomment Created by MeshSmith\n";
+	header += "element vertex " + std::to_string(numVertices) + "\n";
+	header += "property float x\nproperty float y\nproperty float z\n";
+	if (layout.hasNormals) {
+		header += "property float nx\nproperty float ny\nproperty float nz\n";
+	}
+	if (layout.hasTexCoords) {
+		header += "property float s\nproperty float t\n";
+	}
+	if (layout.hasColors) {
+		header += "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n";
+	}
+	header += "element face " + std::to_string(numFaces) + "\n";
+	header += "property list uchar int vertex_indices\nend_header\n";
+
+	if (_options.verbose) {
+		cout << "Writing PLY file: " << fileName << ", vertices: " << numVertices << ", faces: " << numFaces << endl;
+	}
+
+	OutputFile file;
+	if (!file.open(fileName, _options.precompression) || !file.write(header.data(), header.size())) {
+		return Result::error("failed to write PLY file: " + fileName);
+	}
+
+	for (const auto& instance : instances) {
+		Result result = _writeVertices(file, pScene, instance, layout);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	uint32_t vertexOffset = 0;
+	for (const auto& instance : instances) {
+		Result result = _writeFaces(file, pScene, instance, vertexOffset);
+		if (result.isError()) {
+			return result;
+		}
+		vertexOffset += pScene->mMeshes[instance.meshIndex]->mNumVertices;
+	}
+
+	if (!file.close()) {
+		return Result::error("failed to write PLY file: " + fileName);
+	}
+
+	return Result::ok();
+}
+
+Result PlyExporter::_writeVertices(OutputFile& file, const aiScene* pScene,
+	const MeshInstance& instance, const vertexLayout_t& layout)
+{
+	const aiMesh* pMesh = pScene->mMeshes[instance.meshIndex];
+	size_t numVertices = pMesh->mNumVertices;
+
+	// positions only: the vertex records are the position array, write it as is
+	if (layout.byteSize == 3 * sizeof(float) && instance.isIdentity) {
+		file.append(pMesh->mVertices, numVertices * layout.byteSize);
+		return Result::ok();
+	}
+
+	const aiMatrix3x3 normalTransform = instance.normalTransform();
+
+	GeneratedSource source(numVertices, layout.byteSize, [pMesh, &instance, &layout, &normalTransform](size_t first, size_t count, void* pDst) {
+		char* p = (char*)pDst;
+
+		for (size_t i = first; i < first + count; ++i) {
+			aiVector3D position = instance.position(pMesh, i);
+			memcpy(p, &position, 3 * sizeof(float));
+			p += 3 * sizeof(float);
+
+			if (layout.hasNormals) {
+				float normal[3] = { 0.0f, 0.0f, 0.0f };
+				if (pMesh->HasNormals()) {
+					aiVector3D n = pMesh->mNormals[i];
+					if (!instance.isIdentity) {
+						n = normalTransform * n;
+						n.Normalize();
+					}
+					normal[0] = n.x; normal[1] = n.y; normal[2] = n.z;
+				}
+				memcpy(p, normal, sizeof(normal));
+				p += sizeof(normal);
+			}
+			if (layout.hasTexCoords) {
+				float uv[2] = { 0.0f, 0.0f };
+				if (pMesh->HasTextureCoords(0)) {
+					uv[0] = pMesh->mTextureCoords[0][i].x;
+					uv[1] = pMesh->mTextureCoords[0][i].y;
+				}
+				memcpy(p, uv, sizeof(uv));
+				p += sizeof(uv);
+			}
+			if (layout.hasColors) {
+				uint8_t color[4] = { 255, 255, 255, 255 };
+				if (pMesh->HasVertexColors(0)) {
+					const aiColor4D& c = pMesh->mColors[0][i];
+					color[0] = _colorToByte(c.r);
+					color[1] = _colorToByte(c.g);
+					color[2] = _colorToByte(c.b);
+					color[3] = _colorToByte(c.a);
+				}
+				memcpy(p, color, sizeof(color));
+				p += sizeof(color);
+			}
+		}
+	});
+
+	return source.write(file);
+}
+
+Result PlyExporter::_writeFaces(OutputFile& file, const aiScene* pScene,
+	const MeshInstance& instance, uint32_t vertexOffset)
+{
+	const aiMesh* pMesh = pScene->mMeshes[instance.meshIndex];
+	size_t numFaces = pMesh->mNumFaces;
+
+	bool allTriangles = true;
+	for (size_t i = 0; i < numFaces && allTriangles; ++i) {
+		allTriangles = pMesh->mFaces[i].mNumIndices == 3;
+	}
+
+	// triangle records have a fixed size and are packed in parallel
+	if (allTriangles) {
+		const size_t recordSize = 1 + 3 * sizeof(int32_t);
+
+		GeneratedSource source(numFaces, recordSize, [pMesh, vertexOffset, recordSize](size_t first, size_t count, void* pDst) {
+			char* p = (char*)pDst;
+
+			for (size_t i = first; i < first + count; ++i) {
+				const unsigned int* pIndices = pMesh->mFaces[i].mIndices;
+				const uint32_t indices[3] = { vertexOffset + pIndices[0], vertexOffset + pIndices[1], vertexOffset + pIndices[2] };
+				*p = 3;
+				memcpy(p + 1, indices, sizeof(indices));
+				p += recordSize;
+			}
+		});
+
+		return source.write(file);
+	}
+
+	// mixed polygon sizes: records are packed in order, points and lines are skipped
+	std::vector<char> block;
+	block.reserve(_faceBlockSize);
+
+	for (size_t i = 0; i < numFaces; ++i) {
+		const aiFace& face = pMesh->mFaces[i];
+		if (face.mNumIndices < 3) {
+			continue;
+		}
+
+		block.push_back(char(face.mNumIndices));
+		for (size_t j = 0; j < face.mNumIndices; ++j) {
+			uint32_t index = vertexOffset + face.mIndices[j];
+			const char* pIndex = (const char*)&index;
+			block.insert(block.end(), pIndex, pIndex + sizeof(index));
+		}
+
+		if (block.size() >= _faceBlockSize) {
+			if (!file.write(block.data(), block.size())) {
+				return Result::error("failed to write PLY file: " + file.filePath());
+			}
+			block.clear();
+		}
+	}
+
+	if (!block.empty() && !file.write(block.data(), block.size())) {
+		return Result::error("failed to write PLY file: " + file.filePath());
+	}
+
+	return Result::ok();
+}
@@ -0,0 +1,81 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_PLYEXPORTER_H
+#define _MESHSMITH_PLYEXPORTER_H
+
+#include "library.h"
+#include "CompressedFile.h"
+#include "MeshInstance.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+
+struct aiScene;
+
+namespace meshsmith
+{
+	class OutputFile;
+
+	struct PlyExporterOptions
+	{
+		bool verbose;
+		/// Write gzip and/or brotli compressed copies of the output file.
+		Precompression precompression;
+
+		PlyExporterOptions() :
+			verbose(false),
+			precompression(Precompression::None) { }
+	};
+
+	/// Binary little-endian PLY writer. All mesh instances are transformed to scene space
+	/// and merged, as with the Assimp exporter. Vertex and face records are packed in
+	/// parallel into large blocks, which are written with gathered writes.
+	class MESHSMITH_CORE_EXPORT PlyExporter
+	{
+	public:
+		PlyExporter();
+		virtual ~PlyExporter();
+
+		/// Sets the export options to be used for subsequent calls to exportScene().
+		void setOptions(const PlyExporterOptions& options);
+
+		/// Exports the given Assimp scene to the file with the given name, using
+		/// the previously set export options.
+		flow::Result exportScene(const aiScene* pScene, const std::string& fileName);
+
+	protected:
+		struct vertexLayout_t
+		{
+			bool hasNormals;
+			bool hasTexCoords;
+			bool hasColors;
+			size_t byteSize;
+		};
+
+		flow::Result _writeVertices(OutputFile& file, const aiScene* pScene,
+			const MeshInstance& instance, const vertexLayout_t& layout);
+		flow::Result _writeFaces(OutputFile& file, const aiScene* pScene,
+			const MeshInstance& instance, uint32_t vertexOffset);
+
+		PlyExporterOptions _options;
+	};
+}
+
+#endif // _MESHSMITH_PLYEXPORTER_H
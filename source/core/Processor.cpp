@@ -16,19 +16,93 @@
  */
 
 #include "Processor.h"
+#include "Image.h"
+#include "parallel.h"
 
 #include <assimp/scene.h>
 #include <assimp/mesh.h>
 
+#include <algorithm>
 #include <iostream>
+#include <future>
 
 using namespace meshsmith;
 using namespace flow;
 
 
-void Processor::combine(const aiScene* pScene, const std::string& diffuseMap, const std::string& occlusionMap, const std::string& normalMap)
+Result Processor::combine(const std::string& occlusionMap, const std::string& metallicRoughnessMap,
+	const std::string& ormMap, size_t maxSize)
 {
+	size_t occlusionWidth, occlusionHeight, metallicRoughnessWidth, metallicRoughnessHeight, channels;
+	Result result = Image::readInfo(occlusionMap, occlusionWidth, occlusionHeight, channels);
+	if (result.isError()) {
+		return result;
+	}
+	result = Image::readInfo(metallicRoughnessMap, metallicRoughnessWidth, metallicRoughnessHeight, channels);
+	if (result.isError()) {
+		return result;
+	}
+
+	// both maps are scaled down while decoding, the full-size maps are never held in memory
+	size_t commonSize = std::min(std::max(occlusionWidth, occlusionHeight), std::max(metallicRoughnessWidth, metallicRoughnessHeight));
+	if (maxSize > 0) {
+		commonSize = std::min(commonSize, maxSize);
+	}
+
+	Image occlusion;
+	Image metallicRoughness;
+
+	auto occlusionResult = std::async(std::launch::async, [&occlusion, &occlusionMap, commonSize]() {
+		return occlusion.loadScaled(occlusionMap, commonSize);
+	});
+
+	result = metallicRoughness.loadScaled(metallicRoughnessMap, commonSize);
+	Result loadResult = occlusionResult.get();
+
+	if (loadResult.isError()) {
+		return loadResult;
+	}
+	if (result.isError()) {
+		return result;
+	}
+
+	// maps with different aspect ratios are resampled to the smaller extent in each direction
+	size_t width = std::min(occlusion.width(), metallicRoughness.width());
+	size_t height = std::min(occlusion.height(), metallicRoughness.height());
+
+	if (occlusion.width() != width || occlusion.height() != height) {
+		occlusion = occlusion.resized(width, height);
+	}
+	if (metallicRoughness.width() != width || metallicRoughness.height() != height) {
+		metallicRoughness = metallicRoughness.resized(width, height);
+	}
+
+	// roughness and metallic are taken from green and blue, gray maps have them in their only channel
+	size_t mrChannels = metallicRoughness.channels();
+	size_t roughnessChannel = mrChannels >= 3 ? 1 : 0;
+	size_t metallicChannel = mrChannels >= 3 ? 2 : 0;
+	size_t occlusionChannels = occlusion.channels();
+
+	Image orm(width, height, 3);
+
+	parallelFor(0, height, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; ++y) {
+			const uint8_t* pOcclusion = occlusion.pixel(0, y);
+			const uint8_t* pMetallicRoughness = metallicRoughness.pixel(0, y);
+			uint8_t* pDst = orm.data() + y * width * 3;
+
+			for (size_t x = 0; x < width; ++x) {
+				pDst[0] = pOcclusion[0];
+				pDst[1] = pMetallicRoughness[roughnessChannel];
+				pDst[2] = pMetallicRoughness[metallicChannel];
+				pOcclusion += occlusionChannels;
+				pMetallicRoughness += mrChannels;
+				pDst += 3;
+			}
+		}
+	}, 16);
 
+	return orm.save(ormMap);
 }
 
 void Processor::transform(const aiScene* pScene, const Matrix4f& matrix)
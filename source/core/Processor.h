@@ -23,6 +23,9 @@
 #include "math/Vector3T.h"
 #include "math/Matrix4T.h"
 #include "math/Range3T.h"
+#include "core/ResultT.h"
+
+#include <string>
 
 struct aiScene;
 struct aiMesh;
@@ -37,7 +40,12 @@ namespace meshsmith
 		Processor() {};
 
 	public:
-		static void combine(const aiScene* pScene, const std::string& diffuseMap, const std::string& occlusionMap, const std::string& normalMap);
+		/// Packs occlusion (red channel), roughness (green) and metallic (blue) into one ORM map,
+		/// as read by glTF from occlusionTexture and metallicRoughnessTexture. The maps are decoded
+		/// in parallel and scaled down while decoding to the size of the smaller one, limited to
+		/// maxSize if not 0.
+		static flow::Result combine(const std::string& occlusionMap, const std::string& metallicRoughnessMap,
+			const std::string& ormMap, size_t maxSize = 0);
 
 		static void transform(const aiScene* pScene, const flow::Matrix4f& matrix);
 		static void transform(const aiMesh* pMesh, const flow::Matrix4f& matrix);
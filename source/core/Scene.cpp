@@ -18,8 +18,14 @@
 #include "Scene.h"
 #include "Processor.h"
 #include "GLTFExporter.h"
+#include "ObjExporter.h"
+#include "PlyExporter.h"
+#include "StlExporter.h"
+#include "TextureAtlas.h"
+#include "CompressedFile.h"
 
 #include "core/json.h"
+#include "path.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/Exporter.hpp>
@@ -29,6 +35,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 
 using namespace meshsmith;
 using namespace Assimp;
@@ -99,9 +106,19 @@ void Scene::setOptions(const Options& options)
 Result Scene::load()
 {
 	int removeFlags
-		= aiComponent_MATERIALS | aiComponent_TEXTURES | aiComponent_LIGHTS
-		| aiComponent_CAMERAS | aiComponent_ANIMATIONS | aiComponent_BONEWEIGHTS
-		| aiComponent_COLORS;
+		= aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_ANIMATIONS | aiComponent_BONEWEIGHTS;
+
+	// materials reference the maps to be packed into the atlas
+	if (!_options.atlasMaps) {
+		removeFlags |= aiComponent_MATERIALS | aiComponent_TEXTURES;
+	}
+
+	if (!_options.keepColors) {
+		removeFlags |= aiComponent_COLORS;
+	}
+	else if (_options.verbose) {
+		cout << "Keep vertex colors" << endl;
+	}
 
 	if (_options.stripNormals) {
 		if (_options.verbose) {
@@ -118,7 +135,21 @@ Result Scene::load()
 	}
 
 	_pImporter->SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removeFlags);
-	int processFlags = aiProcess_RemoveComponent | aiProcess_JoinIdenticalVertices | aiProcess_Triangulate;
+	int processFlags = aiProcess_RemoveComponent | aiProcess_Triangulate;
+
+	// values of sidecar attribute files follow the vertex order of the input file,
+	// joining vertices would change it
+	bool hasSidecarAttributes = false;
+	for (const auto& attrib : _options.customAttributes) {
+		hasSidecarAttributes = hasSidecarAttributes || attrib.source == CustomAttributeSource::File;
+	}
+
+	if (!hasSidecarAttributes) {
+		processFlags |= aiProcess_JoinIdenticalVertices;
+	}
+	else if (_options.verbose) {
+		cout << "Keep vertex order for sidecar attributes" << endl;
+	}
 
 	_pScene = _pImporter->ReadFile(_options.input, processFlags);
 
@@ -130,7 +161,7 @@ Result Scene::load()
 	return Result::ok();
 }
 
-Result Scene::save() const
+Result Scene::save()
 {
 	string outputFilePath = _options.output.empty() ? _options.input : _options.output;
 	size_t dotPos = outputFilePath.find_last_of(".");
@@ -153,11 +184,101 @@ Result Scene::save() const
 		gltfOptions.metallicRoughnessMapFile = _options.metallicRoughnessMap;
 		gltfOptions.zoneMapFile = _options.zoneMap;
 		gltfOptions.normalMapFile = _options.normalMap;
+
+		if (_options.atlasMaps) {
+			TextureAtlasOptions atlasOptions;
+			atlasOptions.verbose = _options.verbose;
+			atlasOptions.maxSize = _options.atlasMaxSize;
+
+			TextureAtlas atlas;
+			atlas.setOptions(atlasOptions);
+
+			Result atlasResult = atlas.build(_pScene, path(_options.input).parent_path().str(), baseFilePath);
+			if (atlasResult.isError()) {
+				return atlasResult;
+			}
+
+			if (atlas.materialCount() > 0) {
+				// atlased meshes share a material now, merge them into one mesh for a single draw call
+				_pScene = _pImporter->ApplyPostProcessing(aiProcess_PreTransformVertices);
+				if (!_pScene) {
+					return Result::error("failed to merge atlased meshes, reason: " + string(_pImporter->GetErrorString()));
+				}
+
+				// meshes are ordered by material and split by vertex format, the exporter writes
+				// the one mesh with the atlas material
+				std::vector<size_t> atlasMeshes;
+				for (size_t i = 0; i < _pScene->mNumMeshes; ++i) {
+					if (_pScene->mMeshes[i]->mMaterialIndex == atlas.materialIndex()) {
+						atlasMeshes.push_back(i);
+					}
+				}
+
+				if (atlasMeshes.size() != 1) {
+					return Result::error("failed to merge atlased meshes into one mesh, their vertex formats differ");
+				}
+
+				gltfOptions.meshIndex = atlasMeshes.front();
+
+				if (gltfOptions.diffuseMapFile.empty()) {
+					gltfOptions.diffuseMapFile = atlas.diffuseMapFile();
+				}
+				if (gltfOptions.occlusionMapFile.empty()) {
+					gltfOptions.occlusionMapFile = atlas.occlusionMapFile();
+				}
+				if (gltfOptions.normalMapFile.empty()) {
+					gltfOptions.normalMapFile = atlas.normalMapFile();
+				}
+			}
+		}
+
+		if (_options.packORM && !gltfOptions.occlusionMapFile.empty() && !gltfOptions.metallicRoughnessMapFile.empty()) {
+			string ormMapFile = baseFilePath + "-orm.png";
+			if (_options.verbose) {
+				cout << "Pack occlusion, roughness, metallic: " << ormMapFile << endl;
+			}
+
+			// the packed map is written at the size the exporter would scale the occlusion map to
+			auto occlusionSize = _options.mapSizes.find("occlusion");
+			size_t ormMaxSize = occlusionSize != _options.mapSizes.end() ? occlusionSize->second : 0;
+
+			// the pixel budget of decoded maps bounds the side of the packed map
+			if (_options.maxMapPixels > 0) {
+				size_t budgetSize = std::max(size_t(std::sqrt(double(_options.maxMapPixels))), size_t(1));
+				ormMaxSize = ormMaxSize > 0 ? std::min(ormMaxSize, budgetSize) : budgetSize;
+			}
+
+			Result ormResult = Processor::combine(gltfOptions.occlusionMapFile, gltfOptions.metallicRoughnessMapFile, ormMapFile, ormMaxSize);
+			if (ormResult.isError()) {
+				return ormResult;
+			}
+
+			gltfOptions.occlusionMapFile = ormMapFile;
+			gltfOptions.metallicRoughnessMapFile = ormMapFile;
+		}
 		gltfOptions.embedMaps = _options.embedMaps;
 		gltfOptions.useCompression = _options.useCompression;
 		gltfOptions.objectSpaceNormals = _options.objectSpaceNormals;
 		gltfOptions.stripNormals = _options.stripNormals;
 		gltfOptions.stripTexCoords = _options.stripTexCoords;
+		gltfOptions.interleaved = _options.interleaved;
+		gltfOptions.splitMeshes = _options.splitMeshes;
+		gltfOptions.maxBufferSize = size_t(_options.maxBufferSize);
+		gltfOptions.bufferGrouping = _options.bufferGrouping;
+		gltfOptions.progressiveLayout = _options.progressiveLayout;
+		gltfOptions.precompression = _options.precompression;
+		gltfOptions.textureCompression = _options.textureCompression;
+		gltfOptions.webpMaps = _options.webpMaps;
+		gltfOptions.webpQuality = _options.webpQuality;
+		gltfOptions.webpFallback = _options.webpFallback;
+		gltfOptions.maxMapSizes = _options.mapSizes;
+		gltfOptions.maxMapPixels = _options.maxMapPixels;
+		gltfOptions.mapMipmaps = _options.mapMipmaps;
+		gltfOptions.hashCacheFile = _options.hashCache;
+		gltfOptions.colorFormat = _options.colorFormat;
+		gltfOptions.normalEncoding = _options.normalEncoding;
+		gltfOptions.octNormalsOnly = _options.octNormalsOnly;
+		gltfOptions.customAttributes = _options.customAttributes;
 		gltfOptions.writeBinary = writeBinary;
 
 		GLTFDracoOptions dracoOptions;
@@ -166,12 +287,24 @@ Result Scene::save() const
 		dracoOptions.normalsQuantizationBits = _options.normalsQuantizationBits;
 		dracoOptions.genericQuantizationBits = _options.genericQuantizationBits;
 		dracoOptions.compressionLevel = _options.compressionLevel;
+		dracoOptions.maxError = _options.maxError;
+		dracoOptions.maxRelativeError = _options.maxRelativeError;
+		dracoOptions.maxNormalError = _options.maxNormalError;
+		dracoOptions.maxTexCoordError = _options.maxTexCoordError;
+		dracoOptions.maxGenericError = _options.maxGenericError;
+		dracoOptions.encodingMethod = _options.encodingMethod;
+		dracoOptions.sequentialFaceThreshold = _options.sequentialFaceThreshold;
+		dracoOptions.positionPrediction = _options.positionPrediction;
+		dracoOptions.normalsPrediction = _options.normalsPrediction;
+		dracoOptions.texCoordsPrediction = _options.texCoordsPrediction;
 		gltfOptions.draco = dracoOptions;
 
 		GLTFExporter exporter;
 		exporter.setOptions(gltfOptions);
 
 		Result result = exporter.exportScene(_pScene, outputFilePath);
+		_exportReport = exporter.getJsonReport();
+
 		if (result.isError()) {
 			return result;
 		}
@@ -179,6 +312,57 @@ Result Scene::save() const
 		return Result::ok();
 	}
 
+	// native OBJ writer, Assimp's exporter is slow for large meshes
+	if (_options.format == "obj" || _options.format == "objnomtl") {
+		outputFilePath = baseFilePath + ".obj";
+		if (_options.verbose) {
+			cout << "Writing to output file: " << outputFilePath << endl;
+		}
+
+		ObjExporterOptions objOptions;
+		objOptions.verbose = _options.verbose;
+		objOptions.writeMaterials = _options.format == "obj";
+		objOptions.precompression = _options.precompression;
+
+		ObjExporter exporter;
+		exporter.setOptions(objOptions);
+
+		return exporter.exportScene(_pScene, outputFilePath);
+	}
+
+	// native binary PLY and STL writers, records are packed in parallel and written in large blocks
+	if (_options.format == "plyb") {
+		outputFilePath = baseFilePath + ".ply";
+		if (_options.verbose) {
+			cout << "Writing to output file: " << outputFilePath << endl;
+		}
+
+		PlyExporterOptions plyOptions;
+		plyOptions.verbose = _options.verbose;
+		plyOptions.precompression = _options.precompression;
+
+		PlyExporter exporter;
+		exporter.setOptions(plyOptions);
+
+		return exporter.exportScene(_pScene, outputFilePath);
+	}
+
+	if (_options.format == "stlb") {
+		outputFilePath = baseFilePath + ".stl";
+		if (_options.verbose) {
+			cout << "Writing to output file: " << outputFilePath << endl;
+		}
+
+		StlExporterOptions stlOptions;
+		stlOptions.verbose = _options.verbose;
+		stlOptions.precompression = _options.precompression;
+
+		StlExporter exporter;
+		exporter.setOptions(stlOptions);
+
+		return exporter.exportScene(_pScene, outputFilePath);
+	}
+
 	size_t formatCount = aiGetExportFormatCount();
 	for (size_t i = 0; i < formatCount; ++i) {
 		const aiExportFormatDesc* pDesc = aiGetExportFormatDescription(i);
@@ -200,25 +384,31 @@ Result Scene::save() const
 		cout << "Writing to output file: " << outputFilePath << endl;
 	}
 
-	Assimp::Exporter exporter;
 	Assimp::ExportProperties exportProps;
-	int exportFlags = 0;
-	
-	if (_options.joinVertices) {
-		if (_options.verbose) {
-			cout << "Join Identical Vertices" << endl;
-		}
-		exportFlags |= aiProcess_JoinIdenticalVertices;
+
+	Result precompressionResult = CompressedFile::checkAvailable(_options.precompression);
+	if (precompressionResult.isError()) {
+		return precompressionResult;
 	}
 
-	aiReturn result = exporter.Export(_pScene, _options.format,
-		outputFilePath, exportFlags, &exportProps);
+	aiReturn result = _pExporter->Export(_pScene, _options.format,
+		outputFilePath, 0, &exportProps);
 
 	if (result != aiReturn::aiReturn_SUCCESS) {
-		std::string errorString = exporter.GetErrorString();
+		std::string errorString = _pExporter->GetErrorString();
 		return Result::error("failed to write output file: " + outputFilePath + ", reason: " + errorString);
 	}
 
+	// Assimp writes the file itself, compress it afterwards
+	for (auto format : precompressionFormats(_options.precompression)) {
+		if (_options.verbose) {
+			cout << "Compressing output file: " << outputFilePath << CompressedFile::fileExtension(format) << endl;
+		}
+		if (!CompressedFile::compressFile(outputFilePath, format)) {
+			return Result::error("failed to write compressed file: " + outputFilePath + CompressedFile::fileExtension(format));
+		}
+	}
+
 	return Result::ok();
 }
 
@@ -266,6 +456,11 @@ Result Scene::process()
 	return Result::ok();
 }
 
+json Scene::getJsonExportReport() const
+{
+	return _exportReport;
+}
+
 json Scene::getJsonReport() const
 {
 	const aiScene* pScene = _pScene;
@@ -56,12 +56,14 @@ namespace meshsmith
 
 		flow::Result load();
 		flow::Result process();
-		flow::Result save() const;
+		flow::Result save();
 
 		void dump() const;
 		bool isValid() const;
 
 		flow::json getJsonReport() const;
+		/// Returns information about the last save, e.g. the chosen compression settings.
+		flow::json getJsonExportReport() const;
 
 	private:
 		void _dumpMesh(const aiMesh* pMesh) const;
@@ -71,6 +73,7 @@ namespace meshsmith
 		const aiScene* _pScene;
 
 		Options _options;
+		flow::json _exportReport;
 	};
 }
 
@@ -0,0 +1,170 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StlExporter.h"
+#include "OutputFile.h"
+#include "BinaryBuffer.h"
+
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+
+#include <iostream>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
+using namespace meshsmith;
+using namespace flow;
+
+using std::string;
+using std::cout;
+using std::endl;
+
+// normal, three vertices, attribute byte count
+static const size_t _triangleRecordSize = 12 * sizeof(float) + sizeof(uint16_t);
+
+
+StlExporter::StlExporter()
+{
+}
+
+StlExporter::~StlExporter()
+{
+}
+
+void StlExporter::setOptions(const StlExporterOptions& options)
+{
+	_options = options;
+}
+
+Result StlExporter::exportScene(const aiScene* pScene, const string& fileName)
+{
+	Result precompressionResult = CompressedFile::checkAvailable(_options.precompression);
+	if (precompressionResult.isError()) {
+		return precompressionResult;
+	}
+
+	std::vector<MeshInstance> instances = MeshInstance::collect(pScene);
+	size_t numTriangles = 0;
+
+	for (const auto& instance : instances) {
+		const aiMesh* pMesh = pScene->mMeshes[instance.meshIndex];
+
+		// STL holds triangles only, points and lines left by triangulation are skipped
+		for (size_t i = 0; i < pMesh->mNumFaces; ++i) {
+			const aiFace& face = pMesh->mFaces[i];
+			if (face.mNumIndices != 3) {
+				continue;
+			}
+			for (size_t j = 0; j < 3; ++j) {
+				if (face.mIndices[j] >= pMesh->mNumVertices) {
+					return Result::error(string("invalid vertex index in mesh: ") + pMesh->mName.C_Str());
+				}
+			}
+			++numTriangles;
+		}
+	}
+
+	if (numTriangles > std::numeric_limits<uint32_t>::max()) {
+		return Result::error("too many triangles for STL: " + std::to_string(numTriangles));
+	}
+
+	if (_options.verbose) {
+		cout << "Writing STL file: " << fileName << ", triangles: " << numTriangles << endl;
+	}
+
+	// the header must not start with "solid", which would indicate an ASCII file
+	char header[80] = "MeshSmith binary STL";
+	uint32_t triangleCount = uint32_t(numTriangles);
+
+	OutputFile file;
+	if (!file.open(fileName, _options.precompression)) {
+		return Result::error("failed to write STL file: " + fileName);
+	}
+
+	file.append(header, sizeof(header));
+	file.append(&triangleCount, sizeof(triangleCount));
+
+	for (const auto& instance : instances) {
+		Result result = _writeTriangles(file, pScene, instance);
+		if (result.isError()) {
+			return result;
+		}
+	}
+
+	if (!file.close()) {
+		return Result::error("failed to write STL file: " + fileName);
+	}
+
+	return Result::ok();
+}
+
+Result StlExporter::_writeTriangles(OutputFile& file, const aiScene* pScene, const MeshInstance& instance)
+{
+	const aiMesh* pMesh = pScene->mMeshes[instance.meshIndex];
+	size_t numFaces = pMesh->mNumFaces;
+
+	bool allTriangles = true;
+	for (size_t i = 0; i < numFaces && allTriangles; ++i) {
+		allTriangles = pMesh->mFaces[i].mNumIndices == 3;
+	}
+
+	// mixed meshes: the triangles are listed, points and lines are skipped
+	std::vector<uint32_t> triangles;
+	if (!allTriangles) {
+		for (size_t i = 0; i < numFaces; ++i) {
+			if (pMesh->mFaces[i].mNumIndices == 3) {
+				triangles.push_back(uint32_t(i));
+			}
+		}
+	}
+
+	const uint32_t* pTriangles = allTriangles ? nullptr : triangles.data();
+	size_t numTriangles = allTriangles ? numFaces : triangles.size();
+
+	GeneratedSource source(numTriangles, _triangleRecordSize, [pMesh, &instance, pTriangles](size_t first, size_t count, void* pDst) {
+		char* p = (char*)pDst;
+
+		for (size_t t = first; t < first + count; ++t) {
+			const unsigned int* pIndices = pMesh->mFaces[pTriangles ? pTriangles[t] : t].mIndices;
+			aiVector3D v0 = instance.position(pMesh, pIndices[0]);
+			aiVector3D v1 = instance.position(pMesh, pIndices[1]);
+			aiVector3D v2 = instance.position(pMesh, pIndices[2]);
+
+			// face normal from the transformed vertices
+			float ax = v1.x - v0.x, ay = v1.y - v0.y, az = v1.z - v0.z;
+			float bx = v2.x - v0.x, by = v2.y - v0.y, bz = v2.z - v0.z;
+			float nx = ay * bz - az * by, ny = az * bx - ax * bz, nz = ax * by - ay * bx;
+			float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+			const float record[12] = {
+				nx * scale, ny * scale, nz * scale,
+				v0.x, v0.y, v0.z,
+				v1.x, v1.y, v1.z,
+				v2.x, v2.y, v2.z
+			};
+			const uint16_t attributes = 0;
+
+			memcpy(p, record, sizeof(record));
+			memcpy(p + sizeof(record), &attributes, sizeof(attributes));
+			p += _triangleRecordSize;
+		}
+	});
+
+	return source.write(file);
+}
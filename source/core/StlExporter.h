@@ -0,0 +1,70 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_STLEXPORTER_H
+#define _MESHSMITH_STLEXPORTER_H
+
+#include "library.h"
+#include "CompressedFile.h"
+#include "MeshInstance.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+
+struct aiScene;
+
+namespace meshsmith
+{
+	class OutputFile;
+
+	struct StlExporterOptions
+	{
+		bool verbose;
+		/// Write gzip and/or brotli compressed copies of the output file.
+		Precompression precompression;
+
+		StlExporterOptions() :
+			verbose(false),
+			precompression(Precompression::None) { }
+	};
+
+	/// Binary STL writer. All triangles of all mesh instances are written in scene space
+	/// with face normals, as with the Assimp exporter. Triangle records are packed in
+	/// parallel into large blocks, which are written with gathered writes.
+	class MESHSMITH_CORE_EXPORT StlExporter
+	{
+	public:
+		StlExporter();
+		virtual ~StlExporter();
+
+		/// Sets the export options to be used for subsequent calls to exportScene().
+		void setOptions(const StlExporterOptions& options);
+
+		/// Exports the given Assimp scene to the file with the given name, using
+		/// the previously set export options.
+		flow::Result exportScene(const aiScene* pScene, const std::string& fileName);
+
+	protected:
+		flow::Result _writeTriangles(OutputFile& file, const aiScene* pScene, const MeshInstance& instance);
+
+		StlExporterOptions _options;
+	};
+}
+
+#endif // _MESHSMITH_STLEXPORTER_H
@@ -0,0 +1,420 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextureAtlas.h"
+#include "Image.h"
+#include "path.h"
+
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+#include <assimp/material.h>
+
+#include <algorithm>
+#include <future>
+#include <iostream>
+#include <cmath>
+
+#include "parallel.h"
+
+using namespace meshsmith;
+using namespace flow;
+
+using std::string;
+using std::cout;
+using std::endl;
+
+// texture coordinates slightly outside [0, 1] are clamped, larger ones indicate a repeating texture
+static const float _texCoordTolerance = 0.001f;
+
+namespace {
+	struct loadedImage_t
+	{
+		Image image;
+		string error;
+	};
+}
+
+// maps are scaled down to their region while decoded, the full-size map is never held in memory
+static loadedImage_t _loadImage(const string& filePath, size_t maxSize)
+{
+	loadedImage_t result;
+	if (!filePath.empty()) {
+		Result loadResult = result.image.loadScaled(filePath, maxSize);
+		if (loadResult.isError()) {
+			result.error = loadResult.message();
+		}
+	}
+	return result;
+}
+
+static string _resolveTexture(const aiMaterial* pMaterial, aiTextureType type, const string& textureDir)
+{
+	aiString texturePath;
+	if (pMaterial->GetTextureCount(type) == 0 || pMaterial->GetTexture(type, 0, &texturePath) != aiReturn_SUCCESS) {
+		return string{};
+	}
+
+	// embedded textures ("*0", "*1", ...) are not supported
+	string filePath = texturePath.C_Str();
+	if (filePath.empty() || filePath[0] == '*') {
+		return string{};
+	}
+
+	path texture(filePath);
+	if (!texture.is_absolute() && !textureDir.empty()) {
+		texture = path(textureDir) / texture;
+	}
+
+	return texture.str();
+}
+
+static bool _hasUnitTexCoords(const aiMesh* pMesh)
+{
+	if (!pMesh->HasTextureCoords(0)) {
+		return false;
+	}
+
+	const float low = -_texCoordTolerance;
+	const float high = 1.0f + _texCoordTolerance;
+
+	for (size_t i = 0; i < pMesh->mNumVertices; ++i) {
+		const aiVector3D& uv = pMesh->mTextureCoords[0][i];
+		if (uv.x < low || uv.x > high || uv.y < low || uv.y > high) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static size_t _nextPowerOfTwo(size_t value)
+{
+	size_t result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+
+TextureAtlas::TextureAtlas() :
+	_materialIndex(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+}
+
+void TextureAtlas::setOptions(const TextureAtlasOptions& options)
+{
+	_options = options;
+}
+
+Result TextureAtlas::build(const aiScene* pScene, const string& textureDir, const string& baseFilePath)
+{
+	_regions.clear();
+	_materialIndex = 0;
+	_diffuseMapFile.clear();
+	_occlusionMapFile.clear();
+	_normalMapFile.clear();
+
+	_collectMaterials(pScene, textureDir);
+
+	// a single material is already a single texture set
+	if (_regions.size() < 2) {
+		if (_options.verbose) {
+			cout << "Texture atlas: fewer than two textured materials, skipping" << endl;
+		}
+		_regions.clear();
+		return Result::ok();
+	}
+
+	size_t atlasWidth = 0;
+	size_t atlasHeight = 0;
+	if (!_pack(atlasWidth, atlasHeight)) {
+		return Result::error("failed to pack texture atlas, maximum size: " + std::to_string(_options.maxSize));
+	}
+
+	if (_options.verbose) {
+		cout << "Texture atlas: " << _regions.size() << " materials, size: " << atlasWidth << " x " << atlasHeight << endl;
+	}
+
+	bool hasAlpha = false;
+	bool hasOcclusion = false;
+	bool hasNormals = false;
+	for (const auto& region : _regions) {
+		hasAlpha = hasAlpha || region.diffuseHasAlpha;
+		hasOcclusion = hasOcclusion || !region.occlusionFile.empty();
+		hasNormals = hasNormals || !region.normalFile.empty();
+	}
+
+	string diffuseMapFile = baseFilePath + (hasAlpha ? "-diffuse.png" : "-diffuse.jpg");
+	Result result = _renderAtlas(MapType::Diffuse, atlasWidth, atlasHeight, diffuseMapFile);
+	if (result.isError()) {
+		return result;
+	}
+	_diffuseMapFile = diffuseMapFile;
+
+	if (hasOcclusion) {
+		string occlusionMapFile = baseFilePath + "-occlusion.jpg";
+		result = _renderAtlas(MapType::Occlusion, atlasWidth, atlasHeight, occlusionMapFile);
+		if (result.isError()) {
+			return result;
+		}
+		_occlusionMapFile = occlusionMapFile;
+	}
+
+	// normal maps are stored lossless, JPEG artifacts show up as shading noise
+	if (hasNormals) {
+		string normalMapFile = baseFilePath + "-normals.png";
+		result = _renderAtlas(MapType::Normals, atlasWidth, atlasHeight, normalMapFile);
+		if (result.isError()) {
+			return result;
+		}
+		_normalMapFile = normalMapFile;
+	}
+
+	_rewriteTexCoords(pScene, atlasWidth, atlasHeight);
+	return Result::ok();
+}
+
+void TextureAtlas::_collectMaterials(const aiScene* pScene, const string& textureDir)
+{
+	for (size_t i = 0; i < pScene->mNumMaterials; ++i) {
+		const aiMaterial* pMaterial = pScene->mMaterials[i];
+
+		region_t region;
+		region.materialIndex = i;
+		region.diffuseFile = _resolveTexture(pMaterial, aiTextureType_DIFFUSE, textureDir);
+		region.occlusionFile = _resolveTexture(pMaterial, aiTextureType_LIGHTMAP, textureDir);
+		region.normalFile = _resolveTexture(pMaterial, aiTextureType_NORMALS, textureDir);
+
+		if (region.diffuseFile.empty()) {
+			continue;
+		}
+
+		// the atlas region replaces the whole texture, repeating textures can't be atlased
+		bool isUsed = false;
+		bool canAtlas = true;
+		for (size_t j = 0; j < pScene->mNumMeshes && canAtlas; ++j) {
+			const aiMesh* pMesh = pScene->mMeshes[j];
+			if (pMesh->mMaterialIndex == i) {
+				isUsed = true;
+				canAtlas = _hasUnitTexCoords(pMesh);
+			}
+		}
+
+		if (!isUsed || !canAtlas) {
+			if (_options.verbose && isUsed) {
+				cout << "Texture atlas: skipping material #" << i << ", texture coordinates outside [0, 1]" << endl;
+			}
+			continue;
+		}
+
+		if (!Image::isSupported(region.diffuseFile)
+				|| (!region.occlusionFile.empty() && !Image::isSupported(region.occlusionFile))
+				|| (!region.normalFile.empty() && !Image::isSupported(region.normalFile))) {
+			if (_options.verbose) {
+				cout << "Texture atlas: skipping material #" << i << ", unsupported image format" << endl;
+			}
+			continue;
+		}
+
+		size_t channels = 0;
+		Result result = Image::readInfo(region.diffuseFile, region.sourceWidth, region.sourceHeight, channels);
+		if (result.isError()) {
+			if (_options.verbose) {
+				cout << "Texture atlas: skipping material #" << i << ", " << result.message() << endl;
+			}
+			continue;
+		}
+
+		region.diffuseHasAlpha = channels == 2 || channels == 4;
+		region.width = region.height = region.x = region.y = 0;
+		_regions.push_back(region);
+	}
+}
+
+bool TextureAtlas::_pack(size_t& atlasWidth, size_t& atlasHeight)
+{
+	const size_t padding = _options.padding;
+
+	// shelf packing, tallest regions first
+	std::vector<size_t> order(_regions.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+		return _regions[a].sourceHeight > _regions[b].sourceHeight;
+	});
+
+	// halve the resolution of all maps until they fit
+	for (float scale = 1.0f; scale * _options.maxSize >= 1.0f; scale *= 0.5f) {
+		size_t area = 0;
+		size_t maxWidth = 0;
+
+		for (auto& region : _regions) {
+			region.width = std::max(size_t(std::round(region.sourceWidth * scale)), size_t(1));
+			region.height = std::max(size_t(std::round(region.sourceHeight * scale)), size_t(1));
+			area += (region.width + 2 * padding) * (region.height + 2 * padding);
+			maxWidth = std::max(maxWidth, region.width + 2 * padding);
+		}
+
+		size_t width = _nextPowerOfTwo(std::max(size_t(std::ceil(std::sqrt(double(area)))), maxWidth));
+		if (width > _options.maxSize) {
+			continue;
+		}
+
+		size_t shelfX = 0;
+		size_t shelfY = 0;
+		size_t shelfHeight = 0;
+
+		for (size_t index : order) {
+			region_t& region = _regions[index];
+			size_t paddedWidth = region.width + 2 * padding;
+			size_t paddedHeight = region.height + 2 * padding;
+
+			if (shelfX + paddedWidth > width) {
+				shelfY += shelfHeight;
+				shelfX = 0;
+				shelfHeight = 0;
+			}
+
+			region.x = shelfX + padding;
+			region.y = shelfY + padding;
+			shelfX += paddedWidth;
+			shelfHeight = std::max(shelfHeight, paddedHeight);
+		}
+
+		// keep the height a multiple of 4 for block compressed formats
+		size_t height = (shelfY + shelfHeight + 3) & ~size_t(3);
+		if (height <= _options.maxSize) {
+			atlasWidth = width;
+			atlasHeight = height;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+Result TextureAtlas::_renderAtlas(MapType mapType, size_t atlasWidth, size_t atlasHeight, const string& filePath)
+{
+	static const uint8_t diffuseColor[] = { 255, 255, 255, 255 };
+	static const uint8_t occlusionColor[] = { 255 };
+	static const uint8_t normalColor[] = { 128, 128, 255 };
+
+	size_t channels = 3;
+	const uint8_t* pDefaultColor = diffuseColor;
+	const char* pMapName = "diffuse";
+
+	if (mapType == MapType::Diffuse) {
+		for (const auto& region : _regions) {
+			channels = region.diffuseHasAlpha ? 4 : channels;
+		}
+	}
+	else if (mapType == MapType::Occlusion) {
+		channels = 1;
+		pDefaultColor = occlusionColor;
+		pMapName = "occlusion";
+	}
+	else {
+		pDefaultColor = normalColor;
+		pMapName = "normal";
+	}
+
+	Image atlas(atlasWidth, atlasHeight, channels);
+	atlas.fill(0, 0, atlasWidth, atlasHeight, pDefaultColor);
+
+	auto mapFile = [mapType](const region_t& region) -> const string& {
+		return mapType == MapType::Diffuse ? region.diffuseFile
+			: (mapType == MapType::Occlusion ? region.occlusionFile : region.normalFile);
+	};
+
+	// decode the next map while the current one is resampled
+	std::future<loadedImage_t> next = std::async(std::launch::async, _loadImage, mapFile(_regions[0]),
+		std::max(_regions[0].width, _regions[0].height));
+
+	for (size_t i = 0; i < _regions.size(); ++i) {
+		const region_t& region = _regions[i];
+		loadedImage_t current = next.get();
+
+		if (i + 1 < _regions.size()) {
+			const region_t& nextRegion = _regions[i + 1];
+			next = std::async(std::launch::async, _loadImage, mapFile(nextRegion), std::max(nextRegion.width, nextRegion.height));
+		}
+
+		if (!current.error.empty()) {
+			return Result::error(string("failed to read ") + pMapName + " map: " + mapFile(region) + ", reason: " + current.error);
+		}
+
+		if (current.image.isEmpty()) {
+			size_t padding = _options.padding;
+			atlas.fill(region.x - padding, region.y - padding, region.width + 2 * padding, region.height + 2 * padding, pDefaultColor);
+		}
+		else {
+			atlas.resampleFrom(current.image, region.x, region.y, region.width, region.height, _options.padding);
+		}
+	}
+
+	if (_options.verbose) {
+		cout << "Writing " << pMapName << " atlas: " << filePath << endl;
+	}
+
+	return atlas.save(filePath, _options.jpegQuality);
+}
+
+void TextureAtlas::_rewriteTexCoords(const aiScene* pScene, size_t atlasWidth, size_t atlasHeight)
+{
+	_materialIndex = _regions.front().materialIndex;
+
+	std::vector<const region_t*> materialRegions(pScene->mNumMaterials, nullptr);
+	for (const auto& region : _regions) {
+		materialRegions[region.materialIndex] = &region;
+	}
+
+	const float width = float(atlasWidth);
+	const float height = float(atlasHeight);
+
+	for (size_t i = 0; i < pScene->mNumMeshes; ++i) {
+		aiMesh* pMesh = pScene->mMeshes[i];
+		const region_t* pRegion = pMesh->mMaterialIndex < materialRegions.size() ? materialRegions[pMesh->mMaterialIndex] : nullptr;
+		if (!pRegion) {
+			continue;
+		}
+
+		// texture coordinates have their origin at the bottom left, image rows start at the top
+		const float x = float(pRegion->x);
+		const float y = float(pRegion->y);
+		const float w = float(pRegion->width);
+		const float h = float(pRegion->height);
+		aiVector3D* pTexCoords = pMesh->mTextureCoords[0];
+
+		parallelFor(0, pMesh->mNumVertices, [pTexCoords, x, y, w, h, width, height](size_t begin, size_t end) {
+			for (size_t j = begin; j < end; ++j) {
+				aiVector3D& uv = pTexCoords[j];
+				float u = std::min(std::max(uv.x, 0.0f), 1.0f);
+				float v = std::min(std::max(uv.y, 0.0f), 1.0f);
+				uv.x = (x + u * w) / width;
+				uv.y = 1.0f - (y + (1.0f - v) * h) / height;
+			}
+		});
+
+		pMesh->mMaterialIndex = (unsigned int)_materialIndex;
+	}
+}
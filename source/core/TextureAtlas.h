@@ -0,0 +1,108 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_TEXTUREATLAS_H
+#define _MESHSMITH_TEXTUREATLAS_H
+
+#include "library.h"
+
+#include "core/ResultT.h"
+
+#include <string>
+#include <vector>
+
+struct aiScene;
+
+namespace meshsmith
+{
+	struct TextureAtlasOptions
+	{
+		bool verbose;
+		/// Maximum width and height of the atlas, materials are scaled down to fit.
+		size_t maxSize;
+		/// Border around each material's region, repeating its edge pixels against filter bleeding.
+		size_t padding;
+		int jpegQuality;
+
+		TextureAtlasOptions() :
+			verbose(false),
+			maxSize(8192),
+			padding(4),
+			jpegQuality(90)
+		{
+		}
+	};
+
+	/// Packs the diffuse, occlusion and normal maps of all textured materials into one
+	/// atlas per map type and rewrites the texture coordinates of the affected meshes.
+	/// Atlased meshes are assigned to a single material, so they can be merged into one draw call.
+	class MESHSMITH_CORE_EXPORT TextureAtlas
+	{
+	public:
+		TextureAtlas();
+		virtual ~TextureAtlas();
+
+		void setOptions(const TextureAtlasOptions& options);
+
+		/// Builds the atlases from the texture files referenced by the scene's materials, relative
+		/// paths are resolved against textureDir. Writes the atlas images to baseFilePath with
+		/// suffixes "-diffuse", "-occlusion" and "-normals".
+		flow::Result build(const aiScene* pScene, const std::string& textureDir, const std::string& baseFilePath);
+
+		/// Number of materials packed into the atlas, the atlas is only built for two or more.
+		size_t materialCount() const { return _regions.size(); }
+		/// Material index of all atlased meshes.
+		size_t materialIndex() const { return _materialIndex; }
+
+		const std::string& diffuseMapFile() const { return _diffuseMapFile; }
+		const std::string& occlusionMapFile() const { return _occlusionMapFile; }
+		const std::string& normalMapFile() const { return _normalMapFile; }
+
+	protected:
+		enum class MapType { Diffuse, Occlusion, Normals };
+
+		struct region_t
+		{
+			size_t materialIndex;
+			std::string diffuseFile;
+			std::string occlusionFile;
+			std::string normalFile;
+			bool diffuseHasAlpha;
+			size_t sourceWidth;
+			size_t sourceHeight;
+			size_t width;
+			size_t height;
+			size_t x;
+			size_t y;
+		};
+
+		void _collectMaterials(const aiScene* pScene, const std::string& textureDir);
+		bool _pack(size_t& atlasWidth, size_t& atlasHeight);
+		flow::Result _renderAtlas(MapType mapType, size_t atlasWidth, size_t atlasHeight, const std::string& filePath);
+		void _rewriteTexCoords(const aiScene* pScene, size_t atlasWidth, size_t atlasHeight);
+
+		TextureAtlasOptions _options;
+		std::vector<region_t> _regions;
+		size_t _materialIndex;
+
+		std::string _diffuseMapFile;
+		std::string _occlusionMapFile;
+		std::string _normalMapFile;
+	};
+}
+
+#endif // _MESHSMITH_TEXTUREATLAS_H
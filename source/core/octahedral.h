@@ -0,0 +1,124 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_OCTAHEDRAL_H
+#define _MESHSMITH_OCTAHEDRAL_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define MESHSMITH_HAS_SSE2
+# include <emmintrin.h>
+#endif
+
+namespace meshsmith
+{
+	/// Encodes a unit vector to octahedral coordinates in [-1, 1].
+	inline void octahedralEncode(float x, float y, float z, float& u, float& v)
+	{
+		float sum = std::abs(x) + std::abs(y) + std::abs(z);
+		float inverse = sum > 0.0f ? 1.0f / sum : 0.0f;
+		u = x * inverse;
+		v = y * inverse;
+
+		// fold the lower hemisphere over the diagonals
+		if (z < 0.0f) {
+			float foldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+			float foldedV = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+			u = foldedU;
+			v = foldedV;
+		}
+	}
+
+	/// Encodes count unit vectors (float triplets, srcStride floats apart) to octahedral
+	/// coordinates stored as signed normalized integers of type T. The two components of
+	/// each vector are written to pDst, dstStride elements of T apart.
+	template<typename T>
+	void octahedralEncode(const float* pSrc, size_t srcStride, size_t count, T* pDst, size_t dstStride)
+	{
+		const float maxValue = float(std::numeric_limits<T>::max());
+		size_t i = 0;
+
+#if defined(MESHSMITH_HAS_SSE2)
+		// four vectors at a time, the remainder is encoded by the scalar loop below
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 scale = _mm_set1_ps(maxValue);
+
+		for (; i + 4 <= count; i += 4) {
+			const float* p0 = pSrc + i * srcStride;
+			const float* p1 = p0 + srcStride;
+			const float* p2 = p1 + srcStride;
+			const float* p3 = p2 + srcStride;
+
+			__m128 x = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+			__m128 y = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+			__m128 z = _mm_setr_ps(p0[2], p1[2], p2[2], p3[2]);
+
+			__m128 ax = _mm_andnot_ps(signMask, x);
+			__m128 ay = _mm_andnot_ps(signMask, y);
+			__m128 az = _mm_andnot_ps(signMask, z);
+			__m128 sum = _mm_add_ps(_mm_add_ps(ax, ay), az);
+			__m128 valid = _mm_cmpgt_ps(sum, zero);
+			__m128 inverse = _mm_and_ps(valid, _mm_div_ps(one, _mm_or_ps(sum, _mm_andnot_ps(valid, one))));
+
+			__m128 u = _mm_mul_ps(x, inverse);
+			__m128 v = _mm_mul_ps(y, inverse);
+
+			// sign(u), sign(v) with sign(0) = 1
+			__m128 signU = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(u, zero), signMask), one);
+			__m128 signV = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(v, zero), signMask), one);
+			__m128 foldedU = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, v)), signU);
+			__m128 foldedV = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, u)), signV);
+
+			__m128 lower = _mm_cmplt_ps(z, zero);
+			u = _mm_or_ps(_mm_and_ps(lower, foldedU), _mm_andnot_ps(lower, u));
+			v = _mm_or_ps(_mm_and_ps(lower, foldedV), _mm_andnot_ps(lower, v));
+
+			// round to nearest, as std::lrint in the scalar path
+			__m128i qu = _mm_cvtps_epi32(_mm_mul_ps(u, scale));
+			__m128i qv = _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+
+			int32_t resultU[4], resultV[4];
+			_mm_storeu_si128((__m128i*)resultU, qu);
+			_mm_storeu_si128((__m128i*)resultV, qv);
+
+			for (size_t j = 0; j < 4; ++j) {
+				T* pOut = pDst + (i + j) * dstStride;
+				pOut[0] = T(resultU[j]);
+				pOut[1] = T(resultV[j]);
+			}
+		}
+#endif
+
+		for (; i < count; ++i) {
+			const float* p = pSrc + i * srcStride;
+			float u, v;
+			octahedralEncode(p[0], p[1], p[2], u, v);
+
+			T* pOut = pDst + i * dstStride;
+			pOut[0] = T(std::lrint(u * maxValue));
+			pOut[1] = T(std::lrint(v * maxValue));
+		}
+	}
+}
+
+#endif // _MESHSMITH_OCTAHEDRAL_H
@@ -0,0 +1,68 @@
+/**
+ * 3D Foundation Project
+ * Copyright 2019 Smithsonian Institution
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESHSMITH_PARALLEL_H
+#define _MESHSMITH_PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace meshsmith
+{
+	/// Returns the number of threads used for parallel loops.
+	inline size_t parallelThreadCount()
+	{
+		size_t count = std::thread::hardware_concurrency();
+		return count > 0 ? count : 1;
+	}
+
+	/// Splits the range [begin, end) into contiguous blocks of at least minBlockSize
+	/// elements and calls func(blockBegin, blockEnd) for each block in parallel.
+	/// Returns after all blocks have been processed.
+	template<typename Func>
+	void parallelFor(size_t begin, size_t end, Func func, size_t minBlockSize = 4096)
+	{
+		size_t count = end > begin ? end - begin : 0;
+		if (count == 0) {
+			return;
+		}
+
+		minBlockSize = std::max(minBlockSize, size_t(1));
+		size_t numBlocks = std::min(parallelThreadCount(), (count + minBlockSize - 1) / minBlockSize);
+		if (numBlocks < 2) {
+			func(begin, end);
+			return;
+		}
+
+		size_t blockSize = (count + numBlocks - 1) / numBlocks;
+		std::vector<std::thread> threads;
+
+		for (size_t first = begin + blockSize; first < end; first += blockSize) {
+			size_t last = std::min(first + blockSize, end);
+			threads.emplace_back([&func, first, last]() { func(first, last); });
+		}
+
+		func(begin, begin + blockSize);
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+}
+
+#endif // _MESHSMITH_PARALLEL_H